@@ -0,0 +1,168 @@
+#include "ArrayOperations.h"
+
+#include "SValue.h"
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+template < typename NumericT >
+bool isArrayOf( const SValue& s )
+{
+  return s.isType< NumericArray< NumericT > >();
+}
+
+bool isArray( const SValue& s )
+{
+  return isArrayOf< int >( s ) || isArrayOf< double >( s );
+}
+
+/// Call f with the array in s, as either type.
+template < typename F >
+decltype( auto ) visitArray( const SValue& s, F&& f )
+{
+  if ( const IntArray* ints = s.getIf< IntArray >() )
+  {
+    return f( *ints );
+  }
+  return f( s.get< FloatArray >() );
+}
+
+template < typename NumericT >
+NumericArray< NumericT > packList( const QExpr& list )
+{
+  std::vector< NumericT > elements;
+  elements.reserve( list.size() );
+  for ( const SValue& element : list )
+  {
+    elements.push_back( element.get< NumericT >() );
+  }
+  return NumericArray< NumericT >( std::move( elements ) );
+}
+
+SValue* array( SValue* v )
+{
+  Cells& args = v->cellsRequired();
+  REQUIRE( v, args.size() == 1, "array requires 1 argument" );
+  REQUIRE( v, args.front()->isQExpression(), "array expects a QExpression" );
+
+  const QExpr& list = std::as_const( *args.front() ).get< QExpr >();
+  const auto isAll = [ &list ]( auto isType ) { return std::all_of( list.begin(), list.end(), isType ); };
+
+  if ( isAll( []( const SValue& s ) { return s.isType< int >(); } ) )
+  {
+    v->value = packList< int >( list );
+    return v;
+  }
+
+  REQUIRE( v, isAll( []( const SValue& s ) { return s.isType< double >(); } ), "array expects all integers or all floats" );
+  v->value = packList< double >( list );
+  return v;
+}
+
+SValue* arrayList( SValue* v )
+{
+  Cells& args = v->cellsRequired();
+  REQUIRE( v, args.size() == 1, "alist requires 1 argument" );
+  REQUIRE( v, isArray( *args.front() ), "alist expects an array" );
+
+  v->value = visitArray( *args.front(), []( const auto& a ) {
+    QExpr list;
+    for ( std::size_t i = a.size(); i > 0; --i )
+    {
+      list = list.prepend( SValue( a[ i - 1 ] ) );
+    }
+    return list;
+  } );
+  return v;
+}
+
+SValue* arrayLength( SValue* v )
+{
+  Cells& args = v->cellsRequired();
+  REQUIRE( v, args.size() == 1, "alen requires 1 argument" );
+  REQUIRE( v, isArray( *args.front() ), "alen expects an array" );
+
+  v->value = static_cast< int >( visitArray( *args.front(), []( const auto& a ) { return a.size(); } ) );
+  return v;
+}
+
+SValue* arrayGet( SValue* v )
+{
+  Cells& args = v->cellsRequired();
+  REQUIRE( v, args.size() == 2, "aget requires 2 arguments" );
+  REQUIRE( v, isArray( *args[ 0 ] ) && args[ 1 ]->isType< int >(), "aget expects an array and an index" );
+
+  const int index = args[ 1 ]->get< int >();
+  const std::size_t size = visitArray( *args[ 0 ], []( const auto& a ) { return a.size(); } );
+  REQUIRE( v, index >= 0 && static_cast< std::size_t >( index ) < size, "aget index out of range" );
+
+  v->value = visitArray( *args[ 0 ], [ index ]( const auto& a ) { return Value( a[ index ] ); } );
+  return v;
+}
+
+/// Reduce the elements of the array argument with combine.
+/// initial is the result for an empty array. Without it, the array must not be empty.
+template < typename Combine >
+SValue* reduceArray( SValue* v, const std::string& name, Combine combine, bool hasInitial )
+{
+  Cells& args = v->cellsRequired();
+  REQUIRE( v, args.size() == 1, name + " requires 1 argument" );
+  REQUIRE( v, isArray( *args.front() ), name + " expects an array" );
+
+  const std::size_t size = visitArray( *args.front(), []( const auto& a ) { return a.size(); } );
+  REQUIRE( v, hasInitial || size > 0, name + " expects a non-empty array" );
+
+  v->value = visitArray( *args.front(), [ &combine, hasInitial ]( const auto& a ) {
+    using NumericT = std::decay_t< decltype( a[ 0 ] ) >;
+    const NumericT* elements = a.data();
+    const NumericT initial = hasInitial ? NumericT{} : elements[ 0 ];
+    return Value( reduceKernel( a.size(), initial, combine, [ elements ]( std::size_t i ) { return elements[ i ]; } ) );
+  } );
+  return v;
+}
+
+SValue* arraySum( SValue* v )
+{
+  return reduceArray( v, "asum", []( auto x, auto y ) { return x + y; }, true );
+}
+
+SValue* arrayMin( SValue* v )
+{
+  return reduceArray( v, "amin", []( auto x, auto y ) { return std::min( x, y ); }, false );
+}
+
+SValue* arrayMax( SValue* v )
+{
+  return reduceArray( v, "amax", []( auto x, auto y ) { return std::max( x, y ); }, false );
+}
+
+template < typename NumericT >
+Value dot( const NumericArray< NumericT >& x, const NumericArray< NumericT >& y )
+{
+  const NumericT* left = x.data();
+  const NumericT* right = y.data();
+  return reduceKernel(
+    x.size(), NumericT{}, []( NumericT a, NumericT b ) { return a + b; },
+    [ left, right ]( std::size_t i ) { return left[ i ] * right[ i ]; } );
+}
+
+SValue* arrayDot( SValue* v )
+{
+  Cells& args = v->cellsRequired();
+  REQUIRE( v, args.size() == 2, "adot requires 2 arguments" );
+
+  const SValue& x = *args[ 0 ];
+  const SValue& y = *args[ 1 ];
+  if ( isArrayOf< int >( x ) && isArrayOf< int >( y ) )
+  {
+    REQUIRE( v, x.get< IntArray >().size() == y.get< IntArray >().size(), "adot arrays must have the same length" );
+    v->value = dot( x.get< IntArray >(), y.get< IntArray >() );
+    return v;
+  }
+
+  REQUIRE( v, isArrayOf< double >( x ) && isArrayOf< double >( y ), "adot expects two arrays of the same type" );
+  REQUIRE( v, x.get< FloatArray >().size() == y.get< FloatArray >().size(), "adot arrays must have the same length" );
+  v->value = dot( x.get< FloatArray >(), y.get< FloatArray >() );
+  return v;
+}
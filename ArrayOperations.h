@@ -0,0 +1,27 @@
+#pragma once
+
+class SValue;
+
+/// @brief Converts a Q-expression of integers or of floats to a packed array. ( array {1 2 3} )
+SValue* array( SValue* v );
+
+/// @brief Converts a packed array to a Q-expression. ( alist a )
+SValue* arrayList( SValue* v );
+
+/// @brief Gets the length of the array. ( alen a )
+SValue* arrayLength( SValue* v );
+
+/// @brief Gets the element at the index. ( aget a i )
+SValue* arrayGet( SValue* v );
+
+/// @brief Sum of the elements. ( asum a )
+SValue* arraySum( SValue* v );
+
+/// @brief Smallest element of a non-empty array. ( amin a )
+SValue* arrayMin( SValue* v );
+
+/// @brief Largest element of a non-empty array. ( amax a )
+SValue* arrayMax( SValue* v );
+
+/// @brief Dot product of two arrays of the same type and length. ( adot a b )
+SValue* arrayDot( SValue* v );
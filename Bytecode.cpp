@@ -0,0 +1,425 @@
+#include "Bytecode.h"
+#include "Environment.h"
+#include "Evaluator.h"
+#include "Numeric.h"
+
+#include <algorithm>
+#include <functional>
+#include <utility>
+
+bool isBytecodeEnabled = true;
+
+void setUseBytecode( bool use )
+{
+  isBytecodeEnabled = use;
+}
+
+bool useBytecode()
+{
+  return isBytecodeEnabled;
+}
+
+/// Built-ins with their own opcode. They take two arguments.
+struct FastOperation
+{
+  const char* name;
+  OpCode op;
+};
+
+constexpr FastOperation fastOperations[] = {
+  { "+", OpCode::Add },
+  { "-", OpCode::Subtract },
+  { "*", OpCode::Multiply },
+  { "/", OpCode::Divide },
+  { "mod", OpCode::Modulo },
+  { "<", OpCode::Lesser },
+  { "<=", OpCode::LesserEqual },
+  { ">", OpCode::Greater },
+  { ">=", OpCode::GreaterEqual },
+  { "eq", OpCode::Equal },
+  { "neq", OpCode::NotEqual } };
+
+class Compiler
+{
+public:
+  Compiler( const std::vector< Symbol >& captures, const QExpr& formals ) : slots( captures )
+  {
+    for ( const SValue& formal : formals )
+    {
+      if ( formal.get< Symbol >() != variadicSymbol )
+      {
+        slots.push_back( formal.get< Symbol >() );
+      }
+    }
+  }
+
+  std::shared_ptr< Bytecode > bytecode = std::make_shared< Bytecode >();
+
+  void compileExpression( const SValue& node, bool isTail )
+  {
+    if ( const Symbol* symbol = node.getIf< Symbol >() )
+    {
+      // Captures and formals are always bound in the frame. Other names are looked up when the code runs.
+      auto slot = std::find( slots.begin(), slots.end(), *symbol );
+      if ( slot != slots.end() )
+      {
+        emit( OpCode::Slot, slot - slots.begin() );
+      }
+      else
+      {
+        emit( OpCode::Evaluate, addConstant( node ) );
+      }
+    }
+    else if ( const Cells* cells = node.cells(); cells && cells->size() == 1 )
+    {
+      compileExpression( *( *cells )[ 0 ], isTail );
+      return;
+    }
+    else if ( cells && cells->size() > 1 )
+    {
+      compileCall( node, *cells, isTail );
+      return;
+    }
+    else
+    {
+      // Other values, and the empty S-expression, evaluate to themselves.
+      emit( OpCode::Constant, addConstant( node ) );
+    }
+
+    if ( isTail )
+    {
+      emit( OpCode::Return );
+    }
+  }
+
+private:
+  void compileCall( const SValue& node, const Cells& cells, bool isTail )
+  {
+    if ( const Symbol* symbol = cells[ 0 ]->getIf< Symbol >() )
+    {
+      if ( cells.size() == 3 )
+      {
+        for ( const FastOperation& fast : fastOperations )
+        {
+          if ( symbol->label() == fast.name )
+          {
+            const std::size_t guard = emitGuard( *symbol );
+            compileExpression( *cells[ 1 ], false );
+            compileExpression( *cells[ 2 ], false );
+            emit( fast.op, bytecode->code[ guard ].b );
+            finishGuard( node, guard, isTail );
+            return;
+          }
+        }
+      }
+
+      if ( *symbol == conditionalSymbol && cells.size() == 4 && cells[ 2 ]->isQExpression() &&
+           cells[ 3 ]->isQExpression() )
+      {
+        compileConditional( node, cells, isTail );
+        return;
+      }
+    }
+
+    compileGenericCall( cells, isTail );
+  }
+
+  /// The operation and arguments are evaluated in order, then applied.
+  void compileGenericCall( const Cells& cells, bool isTail )
+  {
+    for ( std::size_t i = 0; i < cells.size(); ++i )
+    {
+      compileExpression( *cells[ i ], false );
+    }
+    emit( isTail ? OpCode::TailCall : OpCode::Call, cells.size() - 1 );
+  }
+
+  void compileConditional( const SValue& node, const Cells& cells, bool isTail )
+  {
+    const std::size_t guard = emitGuard( cells[ 0 ]->get< Symbol >() );
+    compileExpression( *cells[ 1 ], false );
+    const std::size_t jumpIfFalse = emit( OpCode::JumpIfFalse );
+
+    // The branches are evaluated as S-expressions.
+    compileBranch( cells[ 2 ]->get< QExpr >(), isTail );
+    const std::size_t jumpToEnd = emit( OpCode::Jump );
+
+    bytecode->code[ jumpIfFalse ].a = here();
+    compileBranch( cells[ 3 ]->get< QExpr >(), isTail );
+
+    bytecode->code[ jumpToEnd ].a = here();
+
+    // A condition that is not a boolean leaves its error as the result.
+    bytecode->code[ jumpIfFalse ].b = finishGuard( node, guard, isTail );
+  }
+
+  void compileBranch( const QExpr& branch, bool isTail )
+  {
+    const SValue sexpr( branch.toCells() );
+    compileExpression( sexpr, isTail );
+  }
+
+  /// Guard a specialized built-in call. The built-in is looked up by name when the body is compiled,
+  /// and the guard checks the symbol is still bound to it when the body runs.
+  std::size_t emitGuard( const Symbol& symbol )
+  {
+    const CoreFunctionEntry* entry = findCoreFunction( symbol );
+    bytecode->symbols.push_back( symbol );
+    bytecode->functions.push_back( entry ? entry->function : nullptr );
+    return emit( OpCode::Guard, bytecode->symbols.size() - 1, bytecode->functions.size() - 1 );
+  }
+
+  /// End a guarded call. If the guard fails, the tree-walker evaluates the original node instead.
+  /// In tail position the node is compiled as a generic tail call, so the caller applies it in constant stack space.
+  /// @return The end of the call, where its result is on the stack.
+  std::uint32_t finishGuard( const SValue& node, std::size_t guard, bool isTail )
+  {
+    const std::size_t jumpToEnd = emit( OpCode::Jump );
+    bytecode->code[ guard ].c = here();
+    if ( isTail )
+    {
+      compileGenericCall( *node.cells(), true );
+    }
+    else
+    {
+      emit( OpCode::Evaluate, addConstant( node ) );
+    }
+
+    const std::uint32_t end = here();
+    bytecode->code[ jumpToEnd ].a = end;
+    if ( isTail )
+    {
+      emit( OpCode::Return );
+    }
+    return end;
+  }
+
+  std::size_t emit( OpCode op, std::size_t a = 0, std::size_t b = 0 )
+  {
+    bytecode->code.push_back(
+      Instruction{ op, static_cast< std::uint32_t >( a ), static_cast< std::uint32_t >( b ) } );
+    return bytecode->code.size() - 1;
+  }
+
+  std::uint32_t addConstant( const SValue& value )
+  {
+    bytecode->constants.push_back( value );
+    return static_cast< std::uint32_t >( bytecode->constants.size() - 1 );
+  }
+
+  std::uint32_t here() const
+  {
+    return static_cast< std::uint32_t >( bytecode->code.size() );
+  }
+
+  // The captures and formals in slot order.
+  std::vector< Symbol > slots;
+};
+
+std::shared_ptr< const Bytecode > compile( const std::vector< Symbol >& captures, const QExpr& formals, const QExpr& body )
+{
+  Compiler compiler( captures, formals );
+  const SValue sexpr( body.toCells() );
+  compiler.compileExpression( sexpr, true );
+  return compiler.bytecode;
+}
+
+bool isBoundTo( const Environment& e, const Symbol& symbol, CoreFunctionPtr function )
+{
+  const SValue* bound = e.find( symbol );
+  const CoreFunction* callable = bound ? bound->getIf< CoreFunction >() : nullptr;
+  const CoreFunctionPtr* target = callable ? callable->target< CoreFunctionPtr >() : nullptr;
+  return target && *target == function;
+}
+
+/// Move the top count values of the stack into cells.
+Cells popCells( std::vector< SValue >& stack, std::size_t count )
+{
+  Cells cells;
+  for ( auto it = stack.end() - count; it != stack.end(); ++it )
+  {
+    cells.append( makeSValue( std::move( *it ) ) );
+  }
+  stack.erase( stack.end() - count, stack.end() );
+  return cells;
+}
+
+/// Call the built-in with the top two values of the stack.
+void callBuiltin( Environment& e, CoreFunctionPtr function, std::vector< SValue >& stack )
+{
+  SValue s( popCells( stack, 2 ) );
+  stack.push_back( std::move( *function( e, &s ) ) );
+}
+
+/// Apply the operator if both values are numbers of the type and the right one is valid for it.
+template < typename NumericT, typename Op >
+bool applyArithmetic( std::vector< SValue >& stack )
+{
+  SValue& left = stack[ stack.size() - 2 ];
+  const NumericT* x = std::as_const( left ).getIf< NumericT >();
+  const NumericT* y = std::as_const( stack.back() ).getIf< NumericT >();
+  if ( !x || !y || Op::check( *y ) )
+  {
+    return false;
+  }
+
+  left.value = Op::apply( *x, *y );
+  stack.pop_back();
+  return true;
+}
+
+/// Apply the operator to two numbers of the same type. Otherwise the built-in handles the arguments and errors.
+template < typename Op >
+void binaryArithmetic( Environment& e, CoreFunctionPtr function, std::vector< SValue >& stack )
+{
+  if ( !applyArithmetic< int, Op >( stack ) && !applyArithmetic< double, Op >( stack ) )
+  {
+    callBuiltin( e, function, stack );
+  }
+}
+
+template < typename NumericT, typename CompareOp >
+bool applyComparison( std::vector< SValue >& stack )
+{
+  SValue& left = stack[ stack.size() - 2 ];
+  const NumericT* x = std::as_const( left ).getIf< NumericT >();
+  const NumericT* y = std::as_const( stack.back() ).getIf< NumericT >();
+  if ( !x || !y )
+  {
+    return false;
+  }
+
+  left.value = CompareOp()( *x, *y ) ? Boolean::True : Boolean::False;
+  stack.pop_back();
+  return true;
+}
+
+/// Compare two numbers of the same type. Otherwise the built-in handles the arguments.
+template < typename CompareOp >
+void binaryComparison( Environment& e, CoreFunctionPtr function, std::vector< SValue >& stack )
+{
+  if ( !applyComparison< int, CompareOp >( stack ) && !applyComparison< double, CompareOp >( stack ) )
+  {
+    callBuiltin( e, function, stack );
+  }
+}
+
+Cells execute( Environment& e, const Bytecode& bytecode )
+{
+  std::vector< SValue > stack;
+  const Instruction* const code = bytecode.code.data();
+  std::size_t pc = 0;
+
+  while ( true )
+  {
+    const Instruction& instruction = code[ pc++ ];
+    const CoreFunctionPtr function =
+      instruction.op >= OpCode::Add ? bytecode.functions[ instruction.a ] : nullptr;
+
+    switch ( instruction.op )
+    {
+    case OpCode::Constant:
+      stack.push_back( bytecode.constants[ instruction.a ] );
+      break;
+
+    case OpCode::Evaluate:
+      stack.push_back( evaluate( e, bytecode.constants[ instruction.a ] ) );
+      break;
+
+    case OpCode::Slot:
+    {
+      const SValue& value = e.slot( instruction.a );
+      stack.push_back( value.isSExpression() ? evaluate( e, value ) : value );
+      break;
+    }
+
+    case OpCode::Call:
+    {
+      Cells cells = popCells( stack, instruction.a + 1 );
+      stack.push_back( evaluateSexpr( e, std::move( cells ) ) );
+      break;
+    }
+
+    case OpCode::TailCall:
+      return popCells( stack, instruction.a + 1 );
+
+    case OpCode::Return:
+      return popCells( stack, 1 );
+
+    case OpCode::Guard:
+      if ( !isBoundTo( e, bytecode.symbols[ instruction.a ], bytecode.functions[ instruction.b ] ) )
+      {
+        pc = instruction.c;
+      }
+      break;
+
+    case OpCode::Jump:
+      pc = instruction.a;
+      break;
+
+    case OpCode::JumpIfFalse:
+    {
+      const SValue condition = std::move( stack.back() );
+      stack.pop_back();
+      if ( const Boolean* b = condition.getIf< Boolean >() )
+      {
+        if ( *b == Boolean::False )
+        {
+          pc = instruction.a;
+        }
+      }
+      else
+      {
+        stack.push_back( SValue( Error( "if expects boolean as first argument" ) ) );
+        pc = instruction.b;
+      }
+      break;
+    }
+
+    case OpCode::Add:
+      binaryArithmetic< Add >( e, function, stack );
+      break;
+
+    case OpCode::Subtract:
+      binaryArithmetic< Subtract >( e, function, stack );
+      break;
+
+    case OpCode::Multiply:
+      binaryArithmetic< Multiply >( e, function, stack );
+      break;
+
+    case OpCode::Divide:
+      binaryArithmetic< Divide >( e, function, stack );
+      break;
+
+    case OpCode::Modulo:
+      binaryArithmetic< Modulo >( e, function, stack );
+      break;
+
+    case OpCode::Lesser:
+      binaryComparison< std::less<> >( e, function, stack );
+      break;
+
+    case OpCode::LesserEqual:
+      binaryComparison< std::less_equal<> >( e, function, stack );
+      break;
+
+    case OpCode::Greater:
+      binaryComparison< std::greater<> >( e, function, stack );
+      break;
+
+    case OpCode::GreaterEqual:
+      binaryComparison< std::greater_equal<> >( e, function, stack );
+      break;
+
+    case OpCode::Equal:
+    case OpCode::NotEqual:
+    {
+      const bool isEqual = stack[ stack.size() - 2 ] == stack.back();
+      stack.pop_back();
+      stack.back().value = isEqual == ( instruction.op == OpCode::Equal ) ? Boolean::True : Boolean::False;
+      break;
+    }
+    }
+  }
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "Evaluator.h"
+#include "SValue.h"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Lambda bodies are compiled to bytecode for a stack machine.
+// The tree-walking evaluator stays the reference. Code the compiler does not specialize is either
+// a generic call, or is handed back to the tree-walker, so both always produce the same results.
+
+enum class OpCode : std::uint8_t
+{
+  Constant, // Push constants[ a ].
+  Evaluate, // Push constants[ a ] evaluated by the tree-walker. Used for symbols that are not in a slot.
+  Slot, // Push the value of the capture or formal in slot a of the frame.
+  Call, // Pop the operation and a arguments, push the result of the call.
+  TailCall, // Pop the operation and a arguments, return them for the caller to apply.
+  Return, // Return the value on top.
+  Guard, // Jump to c unless symbols[ a ] is bound to the built-in functions[ b ].
+  Jump, // Jump to a.
+  JumpIfFalse, // Pop the condition. Jump to a if false. If not a boolean, push an error and jump to b.
+
+  // Pop two arguments and push the result. Arguments without a fast path are passed to functions[ a ].
+  Add,
+  Subtract,
+  Multiply,
+  Divide,
+  Modulo,
+  Lesser,
+  LesserEqual,
+  Greater,
+  GreaterEqual,
+  Equal,
+  NotEqual
+};
+
+struct Instruction
+{
+  OpCode op;
+  std::uint32_t a = 0;
+  std::uint32_t b = 0;
+  std::uint32_t c = 0;
+};
+
+/// @brief A compiled lambda body.
+struct Bytecode
+{
+  std::vector< Instruction > code;
+  std::vector< SValue > constants;
+  std::vector< Symbol > symbols;
+  std::vector< CoreFunctionPtr > functions;
+};
+
+/// Compile the body of a lambda. The body is evaluated as an S-expression in tail position.
+/// Captures and formals are resolved to the slots of the frame. See Environment::useSlots.
+std::shared_ptr< const Bytecode > compile( const std::vector< Symbol >& captures, const QExpr& formals, const QExpr& body );
+
+/// Run the bytecode in the environment.
+/// @return The evaluated cells of the call in tail position, for the caller to apply.
+/// If there is no call in tail position, the only cell is the result.
+Cells execute( Environment& e, const Bytecode& bytecode );
+
+/// Run lambda bodies as bytecode. Otherwise the tree-walker runs them. On by default.
+void setUseBytecode( bool use );
+bool useBytecode();
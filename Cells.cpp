@@ -14,10 +14,11 @@ Cells& Cells::operator=( const Cells& other )
 {
   if ( this != &other )
   {
+    clear();
     data.reserve( other.size() );
-    for ( const auto& i : other.data )
+    for ( auto it = other.cbegin(); it != other.cend(); ++it )
     {
-      data.push_back( std::make_unique< SValue >( *i ) );
+      data.push_back( std::make_unique< SValue >( **it ) );
     }
   }
   return *this;
@@ -33,65 +34,96 @@ Cells& Cells::operator=( Cells&& other ) noexcept
   if ( this != &other )
   {
     data = std::move( other.data );
+    offset = other.offset;
+    other.data.clear();
+    other.offset = 0;
   }
   return *this;
 }
 
 std::size_t Cells::size() const
 {
-  return data.size();
+  return data.size() - offset;
 }
 
 bool Cells::isEmpty() const
 {
-  return data.empty();
+  return offset == data.size();
 }
 
-const Cells::ValueT& Cells::children() const
+std::span< const std::unique_ptr< SValue > > Cells::children() const
 {
-  return data;
+  return { data.data() + offset, size() };
 }
 
-Cells::ValueT& Cells::children()
+std::span< std::unique_ptr< SValue > > Cells::children()
 {
-  return data;
+  return { data.data() + offset, size() };
 }
 
 void Cells::append( std::unique_ptr< SValue > v )
 {
+  // Reclaim taken cells once they are at least half of the data.
+  // Each compaction moves fewer cells than were taken, so appends stay amortized constant time.
+  if ( offset != 0 && offset >= size() )
+  {
+    compact();
+  }
   data.push_back( std::move( v ) );
 }
 
 std::unique_ptr< SValue > Cells::takeFront()
 {
-  std::unique_ptr< SValue > front = std::move( data.front() );
-  data.erase( data.begin() );
+  std::unique_ptr< SValue > front = std::move( data[ offset ] );
+  ++offset;
+  if ( offset == data.size() )
+  {
+    clear();
+  }
   return front;
 }
 
 void Cells::drop( ValueT::iterator begin, ValueT::iterator end )
 {
   data.erase( begin, end );
+  if ( offset == data.size() )
+  {
+    clear();
+  }
 }
 
 void Cells::drop( ValueT::iterator pos )
 {
-  data.erase( pos );
+  if ( pos == begin() )
+  {
+    takeFront();
+  }
+  else
+  {
+    data.erase( pos );
+  }
 }
 
 void Cells::clear()
 {
   data.clear();
+  offset = 0;
+}
+
+void Cells::compact()
+{
+  data.erase( data.begin(), data.begin() + offset );
+  offset = 0;
 }
 
 SValue* Cells::front()
 {
-  return data.front().get();
+  return data[ offset ].get();
 }
 
 const SValue* Cells::front() const
 {
-  return data.front().get();
+  return data[ offset ].get();
 }
 
 SValue* Cells::back()
@@ -106,7 +138,7 @@ const SValue* Cells::back() const
 
 Cells::ValueT::iterator Cells::begin()
 {
-  return data.begin();
+  return data.begin() + offset;
 }
 
 Cells::ValueT::iterator Cells::end()
@@ -116,7 +148,7 @@ Cells::ValueT::iterator Cells::end()
 
 Cells::ValueT::const_iterator Cells::cbegin() const
 {
-  return data.cbegin();
+  return data.cbegin() + offset;
 }
 
 Cells::ValueT::const_iterator Cells::cend() const
@@ -126,18 +158,18 @@ Cells::ValueT::const_iterator Cells::cend() const
 
 SValue* Cells::operator[]( std::size_t index )
 {
-  return data[ index ].get();
+  return data[ offset + index ].get();
 }
 
 const SValue* Cells::operator[]( std::size_t index ) const
 {
-  return data[ index ].get();
+  return data[ offset + index ].get();
 }
 
 bool Cells::operator==( const Cells& other ) const
 {
   return std::equal(
-    data.cbegin(), data.cend(), other.cbegin(), other.cend(), []( const auto& left, const auto& right ) {
+    cbegin(), cend(), other.cbegin(), other.cend(), []( const auto& left, const auto& right ) {
       return *left == *right;
     } );
 }
@@ -1,15 +1,20 @@
 #pragma once
 
+#include "NodeAllocator.h"
+
 #include <memory>
+#include <span>
 #include <vector>
 
 class SValue;
 
 // Cells are Semi-Regular type.
+// Taking the front is constant time. Taken cells are skipped by an offset
+// and reclaimed when the cells are appended to again.
 class Cells
 {
 public:
-  using ValueT = std::vector< std::unique_ptr< SValue > >;
+  using ValueT = std::vector< std::unique_ptr< SValue >, NodeAllocatorAdapter< std::unique_ptr< SValue > > >;
 
   Cells() = default;
   Cells( ValueT data );
@@ -23,8 +28,8 @@ public:
   std::size_t size() const;
   bool isEmpty() const;
 
-  const ValueT& children() const;
-  ValueT& children();
+  std::span< const std::unique_ptr< SValue > > children() const;
+  std::span< std::unique_ptr< SValue > > children();
 
   void append( std::unique_ptr< SValue > v );
 
@@ -51,5 +56,11 @@ public:
   bool operator==( const Cells& other ) const;
 
 private:
+  /// Remove the taken cells from the front of data.
+  void compact();
+
   ValueT data;
+
+  // Index of the first cell. Cells before it were taken.
+  std::size_t offset = 0;
 };
@@ -0,0 +1,114 @@
+#include "CsvReader.h"
+
+#include <stdexcept>
+#include <utility>
+
+CsvReader::CsvReader( RecordCallback onRecord ) : onRecord( std::move( onRecord ) )
+{}
+
+void CsvReader::feed( std::string_view chunk )
+{
+  for ( const char c : chunk )
+  {
+    switch ( state )
+    {
+    case State::LineEnd:
+      // The \n of \r\n ends the same record.
+      state = State::FieldStart;
+      if ( c == '\n' )
+      {
+        break;
+      }
+      [[fallthrough]];
+
+    case State::FieldStart:
+      if ( c == '"' )
+      {
+        state = State::Quoted;
+        break;
+      }
+      state = State::Unquoted;
+      [[fallthrough]];
+
+    case State::Unquoted:
+      if ( c == ',' )
+      {
+        endField();
+      }
+      else if ( c == '\n' || c == '\r' )
+      {
+        endRecord();
+        state = c == '\r' ? State::LineEnd : State::FieldStart;
+      }
+      else
+      {
+        field.push_back( c );
+      }
+      break;
+
+    case State::Quoted:
+      if ( c == '"' )
+      {
+        state = State::QuoteInQuoted;
+      }
+      else
+      {
+        field.push_back( c );
+      }
+      break;
+
+    case State::QuoteInQuoted:
+      // Either an escaped quote or the end of the quoted text.
+      if ( c == '"' )
+      {
+        field.push_back( c );
+        state = State::Quoted;
+      }
+      else
+      {
+        state = State::Unquoted;
+        feed( std::string_view( &c, 1 ) );
+      }
+      break;
+    }
+  }
+}
+
+void CsvReader::finish()
+{
+  if ( state == State::Quoted )
+  {
+    throw std::runtime_error( "Unterminated quoted field in CSV" );
+  }
+
+  if ( state != State::FieldStart && state != State::LineEnd )
+  {
+    endRecord();
+  }
+  else if ( !fields.empty() )
+  {
+    // The last line ended with a comma.
+    endRecord();
+  }
+  state = State::FieldStart;
+}
+
+void CsvReader::endField()
+{
+  fields.push_back( std::move( field ) );
+  field.clear();
+  state = State::FieldStart;
+}
+
+void CsvReader::endRecord()
+{
+  endField();
+
+  // A line without any text is not a record.
+  const bool isEmptyLine = fields.size() == 1 && fields.front().empty();
+  if ( !isEmptyLine )
+  {
+    onRecord( fields );
+  }
+  fields.clear();
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/// @brief Streaming CSV reader. The input is fed in chunks and each complete record is passed to the callback,
+/// so the whole file is never in memory.
+/// Fields are separated by commas and records by line ends. Quoted fields may hold commas, line ends,
+/// and "" for a quote. Empty lines are skipped.
+class CsvReader
+{
+public:
+  using RecordCallback = std::function< void( std::vector< std::string >& fields ) >;
+
+  explicit CsvReader( RecordCallback onRecord );
+
+  /// Read the next chunk of input. A record may continue in the next chunk.
+  void feed( std::string_view chunk );
+
+  /// End of input. Passes on the last record.
+  /// @throws std::runtime_error if a quoted field is not closed.
+  void finish();
+
+private:
+  enum class State
+  {
+    FieldStart,
+    Unquoted,
+    Quoted,
+    QuoteInQuoted,
+    LineEnd
+  };
+
+  void endField();
+  void endRecord();
+
+  RecordCallback onRecord;
+  std::vector< std::string > fields;
+  std::string field;
+  State state = State::FieldStart;
+};
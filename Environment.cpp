@@ -1,30 +1,119 @@
-
 #include "Environment.h"
 #include "SValue.h"
 
+#include <algorithm>
 #include <iomanip>
 
-Environment::Environment( Environment* parent ) : parent( parent )
-{}
+struct Environment::Slot
+{
+  Symbol name;
+  SValue value;
+};
 
-SValue* Environment::get( const Symbol& sym, SValue* v ) const
+Environment::Environment( Environment* parent )
 {
-  auto it = env.find( sym );
+  setParent( parent );
+}
+
+Environment::Environment( const Environment& other ) = default;
+Environment& Environment::operator=( const Environment& other ) = default;
 
-  // Found in local environment.
-  if ( it != env.end() )
+Environment::Environment( Environment&& other ) noexcept = default;
+Environment& Environment::operator=( Environment&& other ) noexcept = default;
+
+Environment::~Environment() = default;
+
+const SValue* Environment::find( const Symbol& sym ) const
+{
+  if ( const SValue* local = findLocal( sym ) )
   {
-    // Copy value.
-    v->value = it->second->value;
+    return local;
+  }
+
+  const Environment& global = root();
+  if ( &global == this )
+  {
+    return nullptr;
+  }
+
+  if ( const SValue* value = global.findLocal( sym ) )
+  {
+    return value;
+  }
+
+  return findInCallers( sym );
+}
+
+const SValue* Environment::findInCallers( const Symbol& sym ) const
+{
+  // A free name in the code of the lambda is unbound. Only names in Q-expressions passed in as data remain.
+  if ( names && std::find( names->begin(), names->end(), sym ) != names->end() )
+  {
+    return nullptr;
+  }
+
+  const Environment& global = root();
+  for ( const Environment* scope = parentScope; scope && scope != &global; scope = scope->parentScope )
+  {
+    if ( const SValue* value = scope->findLocal( sym ) )
+    {
+      return value;
+    }
+  }
+  return nullptr;
+}
+
+const SValue* Environment::findCapture( const Symbol& sym ) const
+{
+  if ( const SValue* local = findLocal( sym ) )
+  {
+    return local;
+  }
+
+  // Globals are looked up when the lambda is called.
+  const Environment& global = root();
+  if ( &global == this || global.findLocal( sym ) )
+  {
+    return nullptr;
+  }
+
+  // A lambda made from a Q-expression passed in as data, e.g. by let, captures the names of the caller.
+  return findInCallers( sym );
+}
+
+const Environment::Slot* Environment::findSlot( const Symbol& sym ) const
+{
+  for ( const Slot& s : slots )
+  {
+    if ( s.name == sym )
+    {
+      return &s;
+    }
+  }
+  return nullptr;
+}
+
+const SValue* Environment::findLocal( const Symbol& sym ) const
+{
+  if ( const Slot* s = findSlot( sym ) )
+  {
+    return &s->value;
   }
-  else if ( parent )
+
+  auto it = env.find( sym );
+  return it != env.end() ? it->second.get() : nullptr;
+}
+
+SValue* Environment::get( const Symbol& sym, SValue* v ) const
+{
+  if ( const SValue* found = find( sym ) )
   {
-    // Try parent.
-    parent->get( sym, v );
+    // Copy value.
+    v->value = found->value;
   }
   else
   {
-    error( v, sym.label + " not found" );
+    error( v, sym.label() + " not found" );
   }
 
   return v;
@@ -32,23 +121,102 @@ SValue* Environment::get( const Symbol& sym, SValue* v ) const
 
 void Environment::set( const Symbol& sym, const SValue& v )
 {
-  env[ sym ] = std::make_shared< SValue >( v );
+  for ( Slot& s : slots )
+  {
+    if ( s.name == sym )
+    {
+      s.value = v;
+      return;
+    }
+  }
+
+  env[ sym ] = std::allocate_shared< SValue >( NodeAllocatorAdapter< SValue >(), v );
 }
 
 void Environment::rootSet( const Symbol& s, const SValue& v )
 {
-  // Find root. An environment with no parent.
-  Environment* root = this;
-  while ( root->parent )
+  Environment& global = rootScope ? *rootScope : *this;
+  global.set( s, v );
+}
+
+const Environment::Bindings& Environment::bindings() const
+{
+  return env;
+}
+
+void Environment::useSlots(
+  const std::vector< Symbol >& captures,
+  const QExpr& formals,
+  const std::shared_ptr< const std::vector< Symbol > >& lambdaNames,
+  Environment* callers )
+{
+  names = lambdaNames;
+
+  std::vector< Slot > previous = std::move( slots );
+  slots.clear();
+  for ( const Symbol& name : captures )
+  {
+    slots.push_back( Slot{ name, SValue() } );
+  }
+  for ( const SValue& formal : formals )
   {
-    root = root->parent;
+    const Symbol& name = formal.get< Symbol >();
+    if ( name != variadicSymbol )
+    {
+      slots.push_back( Slot{ name, SValue() } );
+    }
   }
 
-  root->set( s, v );
+  for ( Slot& s : previous )
+  {
+    if ( !findSlot( s.name ) )
+    {
+      callers->set( s.name, s.value );
+    }
+  }
+  for ( auto& [ symbol, value ] : env )
+  {
+    if ( !findSlot( symbol ) )
+    {
+      callers->env[ symbol ] = std::move( value );
+    }
+  }
+  env.clear();
+}
+
+const SValue& Environment::slot( std::size_t i ) const
+{
+  return slots[ i ].value;
+}
+
+void Environment::setSlot( std::size_t i, const SValue& v )
+{
+  slots[ i ].value = v;
+}
+
+Environment* Environment::parent() const
+{
+  return parentScope;
+}
+
+void Environment::setParent( Environment* p )
+{
+  parentScope = p;
+  rootScope = p && p->rootScope ? p->rootScope : p;
+}
+
+const Environment& Environment::root() const
+{
+  return rootScope ? *rootScope : *this;
 }
 
 std::ostream& operator<<( std::ostream& o, const Environment& e )
 {
+  for ( const auto& s : e.slots )
+  {
+    o << std::setw( 10 ) << s.name << ": ";
+    show( o, s.value ) << '\n';
+  }
   for ( const auto& [ symbol, value ] : e.env )
   {
     o << std::setw( 10 ) << symbol << ": ";
@@ -1,19 +1,39 @@
-
 #pragma once
 
 #include "Symbol.h"
 
+#include <memory>
 #include <unordered_map>
+#include <vector>
 
 class SValue;
+struct QExpr;
 
+/// @brief Bindings of symbols to values.
+/// The root environment holds the globals. The others are frames of lambda calls.
+/// A name is looked up lexically, in the frame and then in the globals.
+/// A Q-expression passed in by a caller as data, e.g. a clause given to select, may name variables of the caller.
+/// So a name that the code of the frame does not contain itself is then looked up in the callers.
 class Environment
 {
 public:
+  using Bindings = std::unordered_map< Symbol, std::shared_ptr< SValue >, SymbolHash >;
+
   Environment( Environment* parent = nullptr );
 
+  Environment( const Environment& other );
+  Environment& operator=( const Environment& other );
+
+  Environment( Environment&& other ) noexcept;
+  Environment& operator=( Environment&& other ) noexcept;
+
+  ~Environment();
+
+  /// The value bound to the symbol. Null if it is not bound.
+  const SValue* find( const Symbol& s ) const;
+
   /// Gets a copy of the value for the given symbol.
-  // Copy is stored in v.
+  // Copy is stored in v. The copy shares the bound value until either is modified.
   SValue* get( const Symbol& s, SValue* v ) const;
 
   /// Define a symbol with a given value. A copy of the value is stored.
@@ -22,16 +42,60 @@ public:
   /// Defines the symbol at the root. A copy of the value is stored.
   void rootSet( const Symbol& s, const SValue& v );
 
-  Environment* parent = nullptr;
+  /// The symbols defined in this environment. Parents and slots are not included.
+  const Bindings& bindings() const;
+
+  /// The value bound in this environment only. Null if it is not bound here.
+  const SValue* findLocal( const Symbol& s ) const;
+
+  /// The value that a lambda created here captures for the symbol. Null for globals and unbound names.
+  const SValue* findCapture( const Symbol& s ) const;
+
+  /// Start a lambda call in this frame. The captures and then the formals become the slots, in order.
+  /// The variadic marker is skipped. Compiled code reads a slot by its position instead of looking up its name.
+  /// Bindings of a previous call in this frame move to callers, unless they are slots again.
+  /// lambdaNames are the symbols in the formals and body of the lambda. They are never looked up in the callers.
+  void useSlots(
+    const std::vector< Symbol >& captures,
+    const QExpr& formals,
+    const std::shared_ptr< const std::vector< Symbol > >& lambdaNames,
+    Environment* callers );
+
+  /// The value of the slot at the position.
+  const SValue& slot( std::size_t i ) const;
+  void setSlot( std::size_t i, const SValue& v );
+
+  Environment* parent() const;
+  void setParent( Environment* p );
 
 private:
   friend std::ostream& operator<<( std::ostream& o, const Environment& e );
 
+  struct Slot;
+
+  /// The slot for the symbol. Null if it has none.
+  const Slot* findSlot( const Symbol& s ) const;
+
+  /// The value bound in a caller, for a name that the code of this frame does not contain. Null otherwise.
+  const SValue* findInCallers( const Symbol& s ) const;
+
+  const Environment& root() const;
+
   // If we want to use a map, then the SValues must be stored as shared_ptr. (or other indirection that supports copy).
   // This is because map can modify the internal buffer and do copies.
   //
   // If using a vector to store, we could use unique_ptr
-  std::unordered_map< Symbol, std::shared_ptr< SValue >, SymbolHash > env;
+  Bindings env;
+
+  std::vector< Slot > slots;
+
+  // The symbols in the code of the lambda called in this frame. Null outside of lambda calls.
+  std::shared_ptr< const std::vector< Symbol > > names;
+
+  Environment* parentScope = nullptr;
+
+  // Null for the root itself.
+  Environment* rootScope = nullptr;
 };
 
 std::ostream& operator<<( std::ostream& o, const Environment& e );
@@ -0,0 +1,68 @@
+#include "EnvironmentImage.h"
+#include "Environment.h"
+#include "MappedFile.h"
+#include "Serializer.h"
+
+#include <stdexcept>
+
+// Image file layout:
+//   magic, format version, key, bindings size, bindings hash, bindings
+constexpr std::string_view imageMagic = "SLISPI";
+constexpr std::uint64_t imageFormatVersion = 3;
+
+void saveImage( const Environment& e, const std::string& path, std::uint64_t key )
+{
+  BinaryWriter bindings;
+  try
+  {
+    serialize( bindings, e );
+  }
+  catch ( const std::exception& )
+  {
+    // Some value cannot be saved. e.g. A function that is not a built-in.
+    return;
+  }
+
+  BinaryWriter header;
+  header.writeString( imageMagic );
+  header.writeVarint( imageFormatVersion );
+  header.writeVarint( key );
+  header.writeVarint( bindings.bytes().size() );
+  header.writeVarint( hashBytes( bindings.bytes() ) );
+
+  writeFileAtomically( path, header.bytes(), bindings.bytes() );
+}
+
+bool loadImage( Environment& e, const std::string& path, std::uint64_t key )
+{
+  MappedFile image( path );
+  if ( !image.isOpen() )
+  {
+    return false;
+  }
+
+  try
+  {
+    BinaryReader reader( image.contents() );
+    if ( reader.readString() != imageMagic ) return false;
+    if ( reader.readVarint() != imageFormatVersion ) return false;
+    if ( reader.readVarint() != key ) return false;
+
+    const std::uint64_t bindingsSize = reader.readVarint();
+    const std::uint64_t bindingsHash = reader.readVarint();
+
+    const std::string_view bindings = reader.remaining();
+    if ( bindings.size() != bindingsSize || hashBytes( bindings ) != bindingsHash ) return false;
+
+    // Restore into a new environment so e is untouched if anything fails.
+    Environment restored( e.parent() );
+    BinaryReader bindingsReader( bindings );
+    deserialize( bindingsReader, restored );
+    e = std::move( restored );
+    return true;
+  }
+  catch ( const std::exception& )
+  {
+    return false;
+  }
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+class Environment;
+
+/// @brief Images save the bindings of a root environment, so it can be restored without evaluating anything.
+/// e.g. After the core functions and the standard library are loaded.
+/// Lambdas are saved with their formals, body, captured variables, and bound arguments. Built-ins are saved by name.
+/// An image is only used with the same key that it was saved with.
+
+/// @brief Write the environment to an image file.
+/// Failures are ignored since the image is only an optimization. e.g. Read-only directories.
+void saveImage( const Environment& e, const std::string& path, std::uint64_t key );
+
+/// @brief Restore the environment from an image file.
+/// @return False if there is no valid image for the key. Then e is not modified.
+bool loadImage( Environment& e, const std::string& path, std::uint64_t key );
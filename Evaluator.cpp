@@ -1,22 +1,35 @@
 
 #include "Evaluator.h"
+#include "ArrayOperations.h"
+#include "Bytecode.h"
+#include "HashMapOperations.h"
 #include "ListOperations.h"
+#include "Memo.h"
 #include "Numeric.h"
+#include "Optimizer.h"
+#include "SequenceOperations.h"
 #include "Ordering.h"
 #include "SValue.h"
+#include "TableOperations.h"
 #include "Utility.h"
+#include "VectorOperations.h"
 
+#include <algorithm>
+#include <functional>
+#include <optional>
 #include <type_traits>
+#include <utility>
+#include <vector>
 
-SValue* evaluateSexpr( Environment& e, SValue* s );
-SValue* evaluateNumeric( const std::string& op, SValue* v );
+SValue evaluateQexpr( Environment& e, const QExpr& q );
 SValue* evaluateDef( Environment& e, SValue* v );
 SValue* evaluateAssign( Environment& e, SValue* v );
 SValue* evaluateLambda( Environment& e, SValue* v );
-SValue* invokeLambda( Lambda&, Environment& e, SValue* v );
 SValue* evalQexpr( Environment& e, SValue* v );
+SValue* evalArgument( SValue* v );
 
 SValue* evalConditional( Environment& e, SValue* v );
+SValue* conditionalBranch( SValue* v );
 
 SValue* evalConjunction( Environment& e, SValue* v );
 SValue* evalDisjunction( Environment& e, SValue* v );
@@ -33,8 +46,6 @@ const Symbol listSymbol( "list" );
 const Symbol joinSymbol( "join" );
 const Symbol evalSymbol( "eval" );
 
-const Symbol defSymbol( "def" );
-const Symbol assignSymbol( "=" );
 const Symbol lambdaSymbol( "\\" );
 
 const Symbol lesserSymbol( "<" );
@@ -46,175 +57,461 @@ const Symbol greaterEqualSymbol( ">=" );
 const Symbol equalSymbol( "eq" );
 const Symbol notEqualSymbol( "neq" );
 
-const Symbol conditionalSymbol( "if" );
-
 const Symbol loadSymbol( "load" );
 const Symbol printSymbol( "print" );
 const Symbol errorSymbol( "error" );
 
-void addCoreFunctions( Environment& e )
+SValue* evalAdd( Environment&, SValue* v )
 {
-  auto bindNumericOp = []( const std::string& op ) -> CoreFunction {
-    return [ op ]( Environment&, SValue* v ) -> SValue* { return evaluateNumeric( op, v ); };
-  };
-
-  e.set( plusSymbol, SValue( bindNumericOp( "+" ) ) );
-  e.set( minusSymbol, SValue( bindNumericOp( "-" ) ) );
-  e.set( multSymbol, SValue( bindNumericOp( "*" ) ) );
-  e.set( divSymbol, SValue( bindNumericOp( "/" ) ) );
-  e.set( Symbol( "mod" ), SValue( bindNumericOp( "mod" ) ) );
-
-  auto bindListOp = []( auto f ) { return [ f ]( Environment&, SValue* v ) -> SValue* { return f( v ); }; };
-
-  e.set( headSymbol, SValue( bindListOp( head ) ) );
-  e.set( tailSymbol, SValue( bindListOp( tail ) ) );
-  e.set( listSymbol, SValue( bindListOp( list ) ) );
-  e.set( joinSymbol, SValue( bindListOp( join ) ) );
-  e.set( Symbol( "len" ), SValue( bindListOp( length ) ) );
-
-  e.set( evalSymbol, SValue( []( Environment& e, SValue* v ) -> SValue* { return evalQexpr( e, v ); } ) );
-  e.set( defSymbol, SValue( evaluateDef ) );
-  e.set( assignSymbol, SValue( evaluateAssign ) );
-  e.set( lambdaSymbol, SValue( evaluateLambda ) );
+  return evaluateNumeric< Add >( v );
+}
 
-  e.set( lesserSymbol, SValue( evalLesser ) );
-  e.set( lesserEqualSymbol, SValue( evalLesserEqual ) );
+SValue* evalSubtract( Environment&, SValue* v )
+{
+  return evaluateNumeric< Subtract >( v );
+}
 
-  e.set( greaterSymbol, SValue( evalGreater ) );
-  e.set( greaterEqualSymbol, SValue( evalGreaterEqual ) );
+SValue* evalMultiply( Environment&, SValue* v )
+{
+  return evaluateNumeric< Multiply >( v );
+}
 
-  e.set( equalSymbol, SValue( evalEquality ) );
-  e.set( notEqualSymbol, SValue( evalNotEqual ) );
+SValue* evalDivide( Environment&, SValue* v )
+{
+  return evaluateNumeric< Divide >( v );
+}
 
-  e.set( conditionalSymbol, SValue( evalConditional ) );
+SValue* evalModulo( Environment&, SValue* v )
+{
+  return evaluateNumeric< Modulo >( v );
+}
 
-  e.set( Symbol( "and" ), SValue( evalConjunction ) );
-  e.set( Symbol( "or" ), SValue( evalDisjunction ) );
-  e.set( Symbol( "not" ), SValue( evalNegation ) );
+template < SValue* ( *listOperation )( SValue* ) >
+SValue* evalListOperation( Environment&, SValue* v )
+{
+  return listOperation( v );
+}
 
-  e.set( loadSymbol, SValue( evalLoad ) );
-  e.set( printSymbol, SValue( evalPrint ) );
-  e.set( errorSymbol, SValue( evalError ) );
-  e.set( Symbol( "show" ), SValue( evalShow ) );
+const std::vector< CoreFunctionEntry >& coreFunctions()
+{
+  static const std::vector< CoreFunctionEntry > functions{
+    { plusSymbol, evalAdd },
+    { minusSymbol, evalSubtract },
+    { multSymbol, evalMultiply },
+    { divSymbol, evalDivide },
+    { Symbol( "mod" ), evalModulo },
+
+    { headSymbol, evalListOperation< head > },
+    { tailSymbol, evalListOperation< tail > },
+    { listSymbol, evalListOperation< list > },
+    { joinSymbol, evalListOperation< join > },
+    { Symbol( "len" ), evalListOperation< length > },
+
+    { Symbol( "map" ), map },
+    { Symbol( "filter" ), filter },
+    { Symbol( "foldl" ), foldl },
+    { Symbol( "scanl" ), scanl },
+    { Symbol( "range" ), range },
+    { Symbol( "nth" ), nth },
+    { Symbol( "last" ), last },
+    { Symbol( "take" ), take },
+    { Symbol( "drop" ), drop },
+    { Symbol( "takewhile" ), takeWhile },
+    { Symbol( "iterate" ), iterate },
+    { Symbol( "sum" ), sum },
+    { Symbol( "product" ), product },
+    { Symbol( "elem" ), elem },
+
+    { Symbol( "vector" ), evalListOperation< vector > },
+    { Symbol( "vlist" ), evalListOperation< vectorList > },
+    { Symbol( "vlen" ), evalListOperation< vectorLength > },
+    { Symbol( "vget" ), evalListOperation< vectorGet > },
+    { Symbol( "vset" ), evalListOperation< vectorSet > },
+    { Symbol( "vpush" ), evalListOperation< vectorPush > },
+    { Symbol( "vslice" ), evalListOperation< vectorSlice > },
+
+    { Symbol( "hmap" ), evalListOperation< hashMap > },
+    { Symbol( "hget" ), evalListOperation< hashMapGet > },
+    { Symbol( "hset" ), evalListOperation< hashMapSet > },
+    { Symbol( "hdel" ), evalListOperation< hashMapDelete > },
+    { Symbol( "hhas" ), evalListOperation< hashMapHas > },
+    { Symbol( "hkeys" ), evalListOperation< hashMapKeys > },
+    { Symbol( "hlen" ), evalListOperation< hashMapLength > },
+
+    { Symbol( "array" ), evalListOperation< array > },
+    { Symbol( "alist" ), evalListOperation< arrayList > },
+    { Symbol( "alen" ), evalListOperation< arrayLength > },
+    { Symbol( "aget" ), evalListOperation< arrayGet > },
+    { Symbol( "asum" ), evalListOperation< arraySum > },
+    { Symbol( "amin" ), evalListOperation< arrayMin > },
+    { Symbol( "amax" ), evalListOperation< arrayMax > },
+    { Symbol( "adot" ), evalListOperation< arrayDot > },
+
+    { Symbol( "table" ), evalListOperation< table > },
+    { Symbol( "tcol" ), evalListOperation< tableColumn > },
+    { Symbol( "tnames" ), evalListOperation< tableNames > },
+    { Symbol( "trows" ), evalListOperation< tableRows > },
+    { Symbol( "tselect" ), evalListOperation< tableSelect > },
+    { Symbol( "tfilter" ), evalListOperation< tableFilter > },
+    { Symbol( "twhere" ), tableWhere },
+    { Symbol( "tgroup" ), evalListOperation< tableGroup > },
+    { Symbol( "tsort" ), evalListOperation< tableSort > },
+    { Symbol( "tcsv" ), evalListOperation< tableCsv > },
+
+    { Symbol( "memo" ), evalListOperation< memo > },
+    { Symbol( "memostats" ), evalListOperation< memoStats > },
+
+    { Symbol( "lazy" ), evalListOperation< lazy > },
+    { Symbol( "lrange" ), evalListOperation< lazyRange > },
+    { Symbol( "collect" ), collect },
+
+    { evalSymbol, evalQexpr },
+    { defSymbol, evaluateDef },
+    { assignSymbol, evaluateAssign },
+    { lambdaSymbol, evaluateLambda },
+
+    { lesserSymbol, evalLesser },
+    { lesserEqualSymbol, evalLesserEqual },
+
+    { greaterSymbol, evalGreater },
+    { greaterEqualSymbol, evalGreaterEqual },
+
+    { equalSymbol, evalEquality },
+    { notEqualSymbol, evalNotEqual },
+
+    { conditionalSymbol, evalConditional },
+
+    { Symbol( "and" ), evalConjunction },
+    { Symbol( "or" ), evalDisjunction },
+    { Symbol( "not" ), evalNegation },
+
+    { loadSymbol, evalLoad },
+    { printSymbol, evalPrint },
+    { errorSymbol, evalError },
+    { Symbol( "show" ), evalShow } };
+
+  return functions;
 }
 
-SValue* evaluate( Environment& e, SValue* v )
+const CoreFunctionEntry* findCoreFunction( const CoreFunction& f )
 {
-  // Symbol
-  if ( auto symbol = v->getIf< Symbol >() )
+  const CoreFunctionPtr* target = f.target< CoreFunctionPtr >();
+  if ( !target )
   {
-    v = e.get( *symbol, v );
+    return nullptr;
   }
 
-  if ( v->isSExpression() )
+  const auto& functions = coreFunctions();
+  auto it = std::find_if(
+    functions.begin(), functions.end(), [ target ]( const CoreFunctionEntry& c ) { return c.function == *target; } );
+  return it != functions.end() ? &*it : nullptr;
+}
+
+const CoreFunctionEntry* findCoreFunction( const Symbol& name )
+{
+  const auto& functions = coreFunctions();
+  auto it = std::find_if(
+    functions.begin(), functions.end(), [ &name ]( const CoreFunctionEntry& c ) { return c.name == name; } );
+  return it != functions.end() ? &*it : nullptr;
+}
+
+void addCoreFunctions( Environment& e )
+{
+  for ( const CoreFunctionEntry& c : coreFunctions() )
   {
-    v = evaluateSexpr( e, v );
+    e.set( c.name, SValue( CoreFunction( c.function ) ) );
   }
+}
 
-  return v;
+const SValue& cellOf( const std::unique_ptr< SValue >& cell )
+{
+  return *cell;
 }
 
-SValue* evaluateSexpr( Environment& e, SValue* s )
+const SValue& cellOf( const SValue& cell )
 {
-  s->foreachCell( [ &e ]( SValue& child ) { std::swap( child, *evaluate( e, &child ) ); } );
+  return cell;
+}
 
-  // Atom.
-  if ( s->isEmpty() )
+/// Evaluate each cell into new cells. The cells are not modified.
+template < typename CellRange >
+Cells evaluateCells( Environment& e, const CellRange& cells )
+{
+  Cells results;
+  for ( const auto& cell : cells )
   {
-    return s;
+    results.append( makeSValue( evaluate( e, cellOf( cell ) ) ) );
   }
+  return results;
+}
 
-  if ( s->size() == 1 )
+SValue evaluate( Environment& e, const SValue& code )
+{
+  // Symbol
+  if ( const Symbol* symbol = code.getIf< Symbol >() )
   {
-    Cells& cells = s->cellsRequired();
-    std::unique_ptr< SValue > a = cells.takeFront();
-    std::swap( *s, *evaluate( e, a.get() ) );
-    return s;
-  }
-
-  Cells& cells = s->cellsRequired();
-  std::unique_ptr< SValue > operation = cells.takeFront();
+    const SValue* bound = e.find( *symbol );
+    if ( !bound )
+    {
+      return SValue( Error( symbol->label() + " not found" ) );
+    }
 
-  if ( auto callable = operation->getIf< CoreFunction >() )
-  {
-    return ( *callable )( e, s );
+    return bound->isSExpression() ? evaluate( e, *bound ) : *bound;
   }
-  else if ( auto l = operation->getIf< Lambda >() )
+
+  if ( const Cells* cells = code.cells() )
   {
-    return invokeLambda( *l, e, s );
+    return evaluateSexpr( e, evaluateCells( e, cells->children() ) );
   }
-  //else if ( operation->isSExpression() && operation->isEmpty() )
-  //{ // Ignore Empty S-expression
-  //  // Special case feature. Allow multiple definitions within an S-expression.
-  //  // e.g.  (def {a} 10) (def {b} 20 ) ( def {c} 30 ) ==> ()
-  //  return evaluate( e, s ); // Evaluate the rest
-  //}
-  else
+
+  // Other values evaluate to themselves. The copy shares the value.
+  return code;
+}
+
+SValue* evaluate( Environment& e, SValue* v )
+{
+  SValue result = evaluate( e, std::as_const( *v ) );
+  *v = std::move( result );
+  return v;
+}
+
+SValue evaluateQexpr( Environment& e, const QExpr& q )
+{
+  return evaluateSexpr( e, evaluateCells( e, q ) );
+}
+
+/// True if the arguments complete the call. Otherwise the call is a partial application.
+bool isFullApplication( const QExpr& formals, std::size_t argumentCount )
+{
+  std::size_t position = 0;
+  for ( const SValue& formal : formals )
   {
-    return error( s, "Operation is not callable" );
+    // The variadic formal takes all remaining arguments, even none.
+    if ( formal.get< Symbol >() == variadicSymbol )
+    {
+      return true;
+    }
+    if ( position == argumentCount )
+    {
+      return false;
+    }
+    ++position;
   }
+
+  // Too many arguments are reported when binding.
+  return true;
 }
 
-SValue* invokeLambda( Lambda& l, Environment& e, SValue* s )
+/// Bind the arguments in s to the formals in the environment. Bound formals are removed from formals.
+SValue* bindArguments( QExpr& formals, Environment& env, SValue* s )
 {
-  Cells& formalCells = l.formals->cellsRequired();
   Cells& argCells = s->cellsRequired();
 
   // Bind all arguments.
   while ( !argCells.isEmpty() )
   {
-    REQUIRE( s, !formalCells.isEmpty(), "Passed to many arguments to function" );
-
-    std::unique_ptr< SValue > formalArg = formalCells.takeFront();
+    REQUIRE( s, !formals.isEmpty(), "Passed to many arguments to function" );
 
-    const Symbol& sym = formalArg->get< Symbol >();
+    const Symbol sym = formals.front().get< Symbol >();
+    formals = formals.tail();
 
     // Special case for variadics.
-    if ( sym.label == "&" )
+    if ( sym == variadicSymbol )
     {
-      std::unique_ptr< SValue > restOfArgsFormal = formalCells.takeFront();
-      REQUIRE( s, formalCells.isEmpty(), "There should only be 1 symbol after &" );
+      REQUIRE( s, formals.size() == 1, "There should only be 1 symbol after &" );
 
       // We need to bind last formal to the remaining input arguments as a Q-expression.
-      l.env.set( restOfArgsFormal->get< Symbol >(), *list( s ) );
-      break;
+      env.set( formals.front().get< Symbol >(), *list( s ) );
+      formals = QExpr();
+      return s;
     }
 
     std::unique_ptr< SValue > realArg = argCells.takeFront();
-    l.env.set( sym, *realArg );
+    env.set( sym, *realArg );
   }
 
   // No arguments passed for variadic. e.g. + 1
-  if ( !formalCells.isEmpty() && formalCells.front()->get< Symbol >().label == "&" )
+  if ( !formals.isEmpty() && formals.front().get< Symbol >() == variadicSymbol )
   {
-    std::unique_ptr< SValue > formalArg = formalCells.takeFront(); // Remove &
+    formals = formals.tail(); // Remove &
 
-    REQUIRE( s, formalCells.size() == 1, "There should only be 1 symbol after &" );
-    std::unique_ptr< SValue > restOfArgsFormal = formalCells.takeFront();
+    REQUIRE( s, formals.size() == 1, "There should only be 1 symbol after &" );
 
     // Bind the formal to an empty Q-expression.
-    l.env.set( restOfArgsFormal->get< Symbol >(), SValue( QExpr() ) );
+    env.set( formals.front().get< Symbol >(), SValue( QExpr() ) );
+    formals = QExpr();
+  }
+
+  return s;
+}
+
+/// The Q-expression that a tail calling built-in evaluates next, e.g. the branch that if takes.
+/// Null if f does not tail call. On an error, v holds the error and its own value is returned.
+const QExpr* tailExpression( const CoreFunction& f, SValue* v )
+{
+  const CoreFunctionPtr* target = f.target< CoreFunctionPtr >();
+  if ( !target || ( *target != evalConditional && *target != evalQexpr ) )
+  {
+    return nullptr;
+  }
+
+  v = *target == evalConditional ? conditionalBranch( v ) : evalArgument( v );
+  return std::as_const( *v ).getIf< QExpr >();
+}
+
+/// Bind the arguments in s to the first formals. s is replaced by a lambda that takes the remaining formals.
+/// The new lambda shares the code of l and only adds the arguments.
+SValue* partialApplication( const Lambda& l, SValue* s )
+{
+  Lambda partial( l );
+  for ( std::unique_ptr< SValue >& argument : s->cellsRequired().children() )
+  {
+    partial.arguments.push_back( std::move( *argument ) );
+  }
+  s->value = std::move( partial );
+  return s;
+}
+
+/// Add the symbols in v to symbols, once each. Symbols in Q-expressions are included, they may be evaluated.
+void collectSymbols( const SValue& v, std::vector< Symbol >& symbols )
+{
+  if ( const Symbol* symbol = v.getIf< Symbol >() )
+  {
+    if ( std::find( symbols.begin(), symbols.end(), *symbol ) == symbols.end() )
+    {
+      symbols.push_back( *symbol );
+    }
+    return;
   }
 
-  // Do full function application, every formal argument is now bound.
-  if ( formalCells.isEmpty() )
+  v.foreachCell( [ &symbols ]( const SValue& child ) { collectSymbols( child, symbols ); } );
+}
+
+/// Start the call of l in the frame. Its captures and arguments from partial application are bound to their slots.
+void enterLambda( Environment& frame, const Lambda& l, Environment* callers )
+{
+  if ( !l.names )
   {
-    l.env.parent = &e;
-    // Make an S-expression and add a lambda copy for evaluation.
-    // The S-expression is so eval can evaluate it.
-    Cells c;
-    c.append( makeSValue( l.body->value ) );
-    s->value = std::move( c );
-    std::swap( *s, *evalQexpr( l.env, s ) );
-    return s;
+    auto names = std::make_shared< std::vector< Symbol > >();
+    collectSymbols( *l.formals, *names );
+    collectSymbols( *l.body, *names );
+    l.names = std::move( names );
   }
+  frame.useSlots( l.captures, std::as_const( *l.formals ).get< QExpr >(), l.names, callers );
 
-  else
+  std::size_t slot = 0;
+  for ( const SValue& value : l.captured )
+  {
+    frame.setSlot( slot++, value );
+  }
+  for ( const SValue& argument : l.arguments )
   {
-    // Partial application, return new lambda
-    // argCount < formalCount
-    s->value = Lambda( l );
-    return s;
+    frame.setSlot( slot++, argument );
+  }
+}
+
+SValue evaluateSexpr( Environment& e, Cells cells )
+{
+  // Calls in tail position loop here instead of recursing, so tail recursion runs in constant stack space.
+  // Tail positions are the body of a lambda and the Q-expressions evaluated by if and eval.
+  Environment* env = &e;
+
+  // Frame for the lambda calls made in tail position. The first call creates it and later calls rebind it.
+  std::optional< Environment > frame;
+
+  // Bindings of the calls before the current tail call. They are not visible lexically, but Q-expressions
+  // passed on by those calls can still name them.
+  std::unique_ptr< Environment > callers;
+
+  while ( true )
+  {
+    // Atom.
+    if ( cells.isEmpty() )
+    {
+      return SValue( std::move( cells ) );
+    }
+
+    if ( cells.size() == 1 )
+    {
+      return std::move( *cells.front() );
+    }
+
+    std::unique_ptr< SValue > operation = cells.takeFront();
+    SValue s( std::move( cells ) );
+
+    if ( auto callable = std::as_const( *operation ).getIf< CoreFunction >() )
+    {
+      if ( const QExpr* next = tailExpression( *callable, &s ) )
+      {
+        cells = evaluateCells( *env, *next );
+        continue;
+      }
+
+      if ( s.isError() )
+      {
+        return s;
+      }
+
+      return std::move( *( *callable )( *env, &s ) );
+    }
+    else if ( auto l = std::as_const( *operation ).getIf< Lambda >() )
+    {
+      QExpr formals = l->remainingFormals();
+
+      if ( !isFullApplication( formals, s.size() ) )
+      {
+        // Partial application, return new lambda
+        // argCount < formalCount
+        return std::move( *partialApplication( *l, &s ) );
+      }
+
+      // Do full function application.
+      if ( !frame )
+      {
+        frame.emplace( env );
+        env = &*frame;
+      }
+      else if ( !callers )
+      {
+        callers = std::make_unique< Environment >( frame->parent() );
+        frame->setParent( callers.get() );
+      }
+      enterLambda( *frame, *l, callers.get() );
+
+      if ( bindArguments( formals, *frame, &s )->isError() )
+      {
+        return s;
+      }
+
+      // The optimized body is only used while the bindings it assumed still hold where it runs.
+      const OptimizedBody* optimized =
+        l->optimized && assumptionsHold( *frame, l->optimized->assumptions ) ? l->optimized.get() : nullptr;
+      const QExpr& body = std::as_const( optimized ? optimized->body : *l->body ).get< QExpr >();
+      if ( useBytecode() )
+      {
+        std::shared_ptr< const Bytecode >& bytecode = optimized ? optimized->bytecode : l->bytecode;
+        if ( !bytecode )
+        {
+          bytecode = compile( l->captures, std::as_const( *l->formals ).get< QExpr >(), body );
+        }
+        cells = execute( *frame, *bytecode );
+      }
+      else
+      {
+        // The body is evaluated where it is. Nothing proportional to its size is copied.
+        cells = evaluateCells( *frame, body );
+      }
+    }
+    //else if ( operation->isSExpression() && operation->isEmpty() )
+    //{ // Ignore Empty S-expression
+    //  // Special case feature. Allow multiple definitions within an S-expression.
+    //  // e.g.  (def {a} 10) (def {b} 20 ) ( def {c} 30 ) ==> ()
+    //  return evaluate( e, s ); // Evaluate the rest
+    //}
+    else
+    {
+      return std::move( *error( &s, "Operation is not callable" ) );
+    }
   }
 }
 
@@ -229,14 +526,35 @@ SValue* evaluateLambda( Environment& e, SValue* v )
   REQUIRE( v, formals->isType< QExpr >(), "First lambda argument must be Q-expression" );
   REQUIRE( v, body->isType< QExpr >(), "Second lambda argument must be Q-expression" );
 
-  Cells& formalCells = formals->cellsRequired();
+  const QExpr& formalList = formals->get< QExpr >();
   const bool allFormalsAreSymbols =
-    std::all_of( formalCells.begin(), formalCells.end(), []( const auto& c ) { return c->isType< Symbol >(); } );
+    std::all_of( formalList.begin(), formalList.end(), []( const SValue& c ) { return c.isType< Symbol >(); } );
 
   REQUIRE( v, allFormalsAreSymbols, "Lambda formals can only contains Symbols" );
 
-  // Create the lambda.
-  v->value = Lambda( Environment(), std::move( formals ), std::move( body ) );
+  Lambda l( std::move( formals ), std::move( body ) );
+
+  // Capture the free variables of the body that are bound in this frame (lexical scoping).
+  // Globals are not captured, they are looked up when the lambda is called.
+  if ( e.parent() )
+  {
+    std::vector< Symbol > symbols;
+    collectSymbols( *l.body, symbols );
+    for ( const Symbol& symbol : symbols )
+    {
+      const bool isFormal = std::any_of(
+        formalList.begin(), formalList.end(), [ &symbol ]( const SValue& c ) { return c.get< Symbol >() == symbol; } );
+      const SValue* value = isFormal ? nullptr : e.findCapture( symbol );
+      if ( value )
+      {
+        l.captures.push_back( symbol );
+        l.captured.push_back( *value );
+      }
+    }
+  }
+
+  optimizeLambda( e, l );
+  v->value = std::move( l );
   return v;
 }
 
@@ -251,20 +569,22 @@ SValue* evaluateDef( Environment& e, SValue* v )
   // where it will bind: x = 10, y = 20
 
   std::unique_ptr< SValue > symbols = cells.takeFront();
-  Cells& symbolCells = symbols->cellsRequired();
 
   REQUIRE( v, symbols->isQExpression(), "def must take a Q-expression for the first argument" );
-  REQUIRE( v, !symbolCells.isEmpty(), "def requires a non-empty Q-expression for first argument" );
-  REQUIRE( v, symbolCells.size() == cells.size(), "Symbol count must match expression count" );
+  const QExpr& symbolList = symbols->get< QExpr >();
+
+  REQUIRE( v, !symbolList.isEmpty(), "def requires a non-empty Q-expression for first argument" );
+  REQUIRE( v, symbolList.size() == cells.size(), "Symbol count must match expression count" );
 
   const bool allSymbolsAreSymbolType =
-    std::all_of( symbolCells.begin(), symbolCells.end(), []( const auto& c ) { return c->isType< Symbol >(); } );
+    std::all_of( symbolList.begin(), symbolList.end(), []( const SValue& c ) { return c.isType< Symbol >(); } );
 
   REQUIRE( v, allSymbolsAreSymbolType, "Cannot define for non-symbol type" );
 
-  for ( std::size_t i = 0; i < symbolCells.size(); ++i )
+  std::size_t i = 0;
+  for ( const SValue& symbol : symbolList )
   {
-    e.rootSet( symbolCells[ i ]->get< Symbol >(), *cells[ i ] );
+    e.rootSet( symbol.get< Symbol >(), *cells[ i++ ] );
   }
 
   return empty( v );
@@ -282,87 +602,124 @@ SValue* evaluateAssign( Environment& e, SValue* v )
   // where it will bind: x = 10, y = 20
 
   std::unique_ptr< SValue > symbols = cells.takeFront();
-  Cells& symbolCells = symbols->cellsRequired();
 
   REQUIRE( v, symbols->isQExpression(), "= must take a Q-expression for the first argument" );
-  REQUIRE( v, !symbolCells.isEmpty(), "= requires a non-empty Q-expression for first argument" );
-  REQUIRE( v, symbolCells.size() == cells.size(), "Symbol count must match expression count" );
+  const QExpr& symbolList = symbols->get< QExpr >();
+
+  REQUIRE( v, !symbolList.isEmpty(), "= requires a non-empty Q-expression for first argument" );
+  REQUIRE( v, symbolList.size() == cells.size(), "Symbol count must match expression count" );
 
   const bool allSymbolsAreSymbolType =
-    std::all_of( symbolCells.begin(), symbolCells.end(), []( const auto& c ) { return c->isType< Symbol >(); } );
+    std::all_of( symbolList.begin(), symbolList.end(), []( const SValue& c ) { return c.isType< Symbol >(); } );
 
   REQUIRE( v, allSymbolsAreSymbolType, "Cannot define for non-symbol type" );
 
-  for ( std::size_t i = 0; i < symbolCells.size(); ++i )
+  std::size_t i = 0;
+  for ( const SValue& symbol : symbolList )
   {
-    e.set( symbolCells[ i ]->get< Symbol >(), *cells[ i ] );
+    e.set( symbol.get< Symbol >(), *cells[ i++ ] );
   }
 
   return empty( v );
 }
 
-SValue* evaluateNumeric( const std::string& op, SValue* v )
+/// @brief Checks the argument of eval.
+/// @return The Q-expression to evaluate, or v holding an error.
+SValue* evalArgument( SValue* v )
 {
-  Cells& cells = v->cellsRequired();
-  if ( cells.front()->isType< int >() )
-  {
-    return evaluateNumericT< int >( op, v );
-  }
+  Cells& args = v->cellsRequired();
+  REQUIRE( v, args.size() == 1, "eval requires 1 argument" );
 
-  // Fall back to float.
-  return evaluateNumericT< double >( op, v );
+  SValue* qexpr = args.front();
+  REQUIRE( v, qexpr->isQExpression(), "eval expects a QExpression" );
+  return qexpr;
 }
 
 /// @brief Evaluate the Q-expression as an S-expression.
 SValue* evalQexpr( Environment& e, SValue* v )
 {
-  Cells& args = v->cellsRequired();
-  REQUIRE( v, args.size() == 1, "eval requires 1 argument" );
+  const SValue* qexpr = evalArgument( v );
+  if ( qexpr->isError() )
+  {
+    return v;
+  }
 
-  SValue* qexpr = args.front();
-  REQUIRE( v, qexpr->isQExpression(), "eval expects a QExpression" );
+  // Evaluate the Q-expression cells as an S-expression.
+  *v = evaluateQexpr( e, qexpr->get< QExpr >() );
+  return v;
+}
 
-  Cells& qexprCells = qexpr->cellsRequired();
+/// @brief Checks the arguments of if.
+/// @return The Q-expression of the branch to take, or v holding an error.
+SValue* conditionalBranch( SValue* v )
+{
+  Cells& cells = v->cellsRequired();
+  REQUIRE( v, cells.size() == 3, "if requires 3 arguments" );
+  REQUIRE( v, cells[ 0 ]->isType< Boolean >(), "if expects boolean as first argument" );
+  REQUIRE( v, cells[ 1 ]->isQExpression(), "if expects Q-expression as second argument" );
+  REQUIRE( v, cells[ 2 ]->isQExpression(), "if expects Q-expression as third argument" );
 
-  // Move the Q-expression cells into an S-expression.
-  v->value = Cells{ std::move( qexprCells ) };
-  return evaluate( e, v );
+  // The first branch if true, otherwise the second.
+  return cells[ 0 ]->get< Boolean >() == Boolean::True ? cells[ 1 ] : cells[ 2 ];
 }
 
 SValue* evalConditional( Environment& e, SValue* v )
 {
-  Cells& cells = v->cellsRequired();
-  std::unique_ptr< SValue > condition = cells.takeFront();
-  REQUIRE( v, condition->isType< Boolean >(), "if expects boolean as first argument" );
+  const SValue* branch = conditionalBranch( v );
+  if ( branch->isError() )
+  {
+    return v;
+  }
 
-  std::unique_ptr< SValue > first = cells.takeFront();
-  REQUIRE( v, first->isQExpression(), "if expects Q-expression as second argument" );
+  // Evaluate the branch as an S-expression.
+  *v = evaluateQexpr( e, branch->get< QExpr >() );
+  return v;
+}
 
-  std::unique_ptr< SValue > second = cells.takeFront();
-  REQUIRE( v, second->isQExpression(), "if expects Q-expression as third argument" );
+/// True if the cells are masks, integer arrays of the same length. e.g. the results of ( < xs 3 )
+bool areMasks( const Cells& cells )
+{
+  const IntArray* first = cells.isEmpty() ? nullptr : cells.front()->getIf< IntArray >();
+  return first && std::all_of( cells.cbegin(), cells.cend(), [ first ]( const auto& s ) {
+           const IntArray* mask = s->getIf< IntArray >();
+           return mask && mask->size() == first->size();
+         } );
+}
 
-  if ( condition->get< Boolean >() == Boolean::True )
-  {
-    // Make the first argument to an S-expression so it can be evaulated.
-    v->value = Cells( std::move( first->cellsRequired() ) );
-    return evaluate( e, v );
-  }
-  else
+/// Combine the masks element by element. The result has 1 where the operation holds for the elements.
+template < typename LogicalOp >
+SValue* combineMasks( SValue* v )
+{
+  const Cells& cells = v->cellsRequired();
+  const int* first = cells.front()->get< IntArray >().data();
+  std::vector< int > result( cells.front()->get< IntArray >().size() );
+  int* out = result.data();
+  mapKernel( result.size(), out, [ first ]( std::size_t i ) { return static_cast< int >( first[ i ] != 0 ); } );
+  for ( std::size_t c = 1; c < cells.size(); ++c )
   {
-    // Make the second argument to an S-expression so it can be evaulated.
-    v->value = Cells( std::move( second->cellsRequired() ) );
-    return evaluate( e, v );
+    const int* mask = cells[ c ]->get< IntArray >().data();
+    mapKernel( result.size(), out, [ out, mask ]( std::size_t i ) {
+      return static_cast< int >( LogicalOp()( out[ i ] != 0, mask[ i ] != 0 ) );
+    } );
   }
+
+  v->value = IntArray( std::move( result ) );
+  return v;
 }
 
-// Logical AND
+// Logical AND, of booleans or of masks element by element
 SValue* evalConjunction( Environment& e, SValue* v )
 {
   Cells& cells = v->cellsRequired();
+  if ( areMasks( cells ) )
+  {
+    return combineMasks< std::logical_and<> >( v );
+  }
+
   const bool allBooleans =
     std::all_of( cells.cbegin(), cells.cend(), []( const auto& s ) { return s->isType< Boolean >(); } );
 
-  REQUIRE( v, allBooleans, "and expects booleans" );
+  REQUIRE( v, allBooleans, "and expects booleans or masks of the same length" );
 
   const bool result = std::all_of(
     cells.cbegin(), cells.cend(), []( const auto& s ) { return s->get< Boolean >() == Boolean::True ? true : false; } );
@@ -371,14 +728,19 @@ SValue* evalConjunction( Environment& e, SValue* v )
   return v;
 }
 
-// Logical OR
+// Logical OR, of booleans or of masks element by element
 SValue* evalDisjunction( Environment& e, SValue* v )
 {
   Cells& cells = v->cellsRequired();
+  if ( areMasks( cells ) )
+  {
+    return combineMasks< std::logical_or<> >( v );
+  }
+
   const bool allBooleans =
     std::all_of( cells.cbegin(), cells.cend(), []( const auto& s ) { return s->isType< Boolean >(); } );
 
-  REQUIRE( v, allBooleans, "or expects booleans" );
+  REQUIRE( v, allBooleans, "or expects booleans or masks of the same length" );
 
   const bool result = std::any_of(
     cells.cbegin(), cells.cend(), []( const auto& s ) { return s->get< Boolean >() == Boolean::True ? true : false; } );
@@ -387,14 +749,24 @@ SValue* evalDisjunction( Environment& e, SValue* v )
   return v;
 }
 
-// Logical NOT
+// Logical NOT, of a boolean or of a mask element by element
 SValue* evalNegation( Environment& e, SValue* v )
 {
   REQUIRE( v, v->size() == 1, "not expects one argument" );
 
   Cells& cells = v->cellsRequired();
   SValue* s = cells.front();
-  REQUIRE( v, s->isType< Boolean >(), "not expects a boolean" );
+  if ( const IntArray* mask = s->getIf< IntArray >() )
+  {
+    const int* elements = mask->data();
+    std::vector< int > result( mask->size() );
+    mapKernel(
+      result.size(), result.data(), [ elements ]( std::size_t i ) { return static_cast< int >( elements[ i ] == 0 ); } );
+    v->value = IntArray( std::move( result ) );
+    return v;
+  }
+
+  REQUIRE( v, s->isType< Boolean >(), "not expects a boolean or a mask" );
 
   v->value = s->get< Boolean >() == Boolean::True ? Boolean::False : Boolean::True;
   return v;
@@ -1,6 +1,47 @@
 #pragma once
 
 #include "Environment.h"
+#include "SValue.h"
 
+#include <utility>
+#include <vector>
+
+using CoreFunctionPtr = SValue* ( * )( Environment&, SValue* );
+
+/// A built-in function and the symbol it is bound to.
+/// The name is the stable ID of the function. e.g. for environment images.
+struct CoreFunctionEntry
+{
+  Symbol name;
+  CoreFunctionPtr function;
+};
+
+/// All built-in functions.
+const std::vector< CoreFunctionEntry >& coreFunctions();
+
+/// Find the built-in that f holds. Null if f is not a built-in.
+const CoreFunctionEntry* findCoreFunction( const CoreFunction& f );
+
+/// Find the built-in with the name. Null if there is none.
+const CoreFunctionEntry* findCoreFunction( const Symbol& name );
+
+/// Evaluate the code. The code is not modified, the result is a new value.
+SValue evaluate( Environment& e, const SValue& code );
+
+/// Apply the operation in the first cell to the arguments in the rest. The cells are already evaluated.
+/// An empty S-expression evaluates to itself, and a single cell to its value.
+SValue evaluateSexpr( Environment& e, Cells cells );
+
+/// Call f with the arguments, like the S-expression ( f args... ).
+template < typename... Args >
+SValue call( Environment& e, const SValue& f, Args&&... args )
+{
+  Cells cells;
+  cells.append( makeSValue( f ) );
+  ( cells.append( makeSValue( std::forward< Args >( args ) ) ), ... );
+  return evaluateSexpr( e, std::move( cells ) );
+}
+
+/// Evaluate s and replace it with the result.
 SValue* evaluate( Environment& e, SValue* s );
 void addCoreFunctions( Environment& e );
@@ -0,0 +1,325 @@
+#include "HashMap.h"
+#include "SValue.h"
+
+#include <bit>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Bits of the hash used by each level of the trie.
+constexpr unsigned bitsPerLevel = 5;
+constexpr unsigned hashBits = sizeof( std::size_t ) * 8;
+
+/// A key and its value, or a child node for the keys whose hashes share the bits so far.
+/// The key and value of a child entry are unused.
+struct Entry
+{
+  std::size_t hash = 0;
+  SValue key;
+  SValue value;
+  std::shared_ptr< const HashMap::Node > child;
+};
+
+/// The bitmap has a bit for each of the 32 slots in use. The entries are stored in slot order.
+/// Below the last level, the node holds the keys with the same hash in any order.
+struct HashMap::Node
+{
+  std::uint32_t bitmap = 0;
+  std::vector< Entry > entries;
+};
+
+using NodePtr = std::shared_ptr< const HashMap::Node >;
+using Node = HashMap::Node;
+
+std::size_t KeyHash::operator()( const SValue& key ) const
+{
+  if ( const Symbol* symbol = key.getIf< Symbol >() )
+  {
+    return SymbolHash()( *symbol );
+  }
+  if ( const int* i = key.getIf< int >() )
+  {
+    return std::hash< int >()( *i );
+  }
+  return std::hash< std::string >()( key.get< std::string >() );
+}
+
+std::uint32_t slotBit( std::size_t hash, unsigned shift )
+{
+  return std::uint32_t( 1 ) << ( ( hash >> shift ) & ( ( 1u << bitsPerLevel ) - 1 ) );
+}
+
+/// Position of the slot in the entries.
+std::size_t entryIndex( const Node& node, std::uint32_t bit )
+{
+  return std::popcount( node.bitmap & ( bit - 1 ) );
+}
+
+bool isCollisionLevel( unsigned shift )
+{
+  return shift >= hashBits;
+}
+
+NodePtr makeNode( Node node )
+{
+  return std::allocate_shared< Node >( NodeAllocatorAdapter< Node >(), std::move( node ) );
+}
+
+/// A node with both entries, which are leaves with different keys.
+NodePtr makePair( Entry a, Entry b, unsigned shift )
+{
+  Node node;
+  if ( isCollisionLevel( shift ) )
+  {
+    node.entries.push_back( std::move( a ) );
+    node.entries.push_back( std::move( b ) );
+    return makeNode( std::move( node ) );
+  }
+
+  const std::uint32_t bitA = slotBit( a.hash, shift );
+  const std::uint32_t bitB = slotBit( b.hash, shift );
+  if ( bitA == bitB )
+  {
+    node.bitmap = bitA;
+    node.entries.push_back( Entry{ a.hash, SValue( 0 ), SValue( 0 ), makePair( std::move( a ), std::move( b ), shift + bitsPerLevel ) } );
+    return makeNode( std::move( node ) );
+  }
+
+  node.bitmap = bitA | bitB;
+  if ( bitB < bitA )
+  {
+    std::swap( a, b );
+  }
+  node.entries.push_back( std::move( a ) );
+  node.entries.push_back( std::move( b ) );
+  return makeNode( std::move( node ) );
+}
+
+const SValue* findEntry( const Node& node, std::size_t hash, const SValue& key, unsigned shift )
+{
+  if ( isCollisionLevel( shift ) )
+  {
+    for ( const Entry& entry : node.entries )
+    {
+      if ( entry.key == key )
+      {
+        return &entry.value;
+      }
+    }
+    return nullptr;
+  }
+
+  const std::uint32_t bit = slotBit( hash, shift );
+  if ( ( node.bitmap & bit ) == 0 )
+  {
+    return nullptr;
+  }
+
+  const Entry& entry = node.entries[ entryIndex( node, bit ) ];
+  if ( entry.child )
+  {
+    return findEntry( *entry.child, hash, key, shift + bitsPerLevel );
+  }
+  return entry.hash == hash && entry.key == key ? &entry.value : nullptr;
+}
+
+/// The node with the entry set. The path to it is copied, the rest is shared.
+NodePtr setEntry( const Node& node, Entry leaf, unsigned shift, bool& isAdded )
+{
+  Node copy = node;
+  if ( isCollisionLevel( shift ) )
+  {
+    for ( Entry& entry : copy.entries )
+    {
+      if ( entry.key == leaf.key )
+      {
+        entry.value = std::move( leaf.value );
+        return makeNode( std::move( copy ) );
+      }
+    }
+    copy.entries.push_back( std::move( leaf ) );
+    isAdded = true;
+    return makeNode( std::move( copy ) );
+  }
+
+  const std::uint32_t bit = slotBit( leaf.hash, shift );
+  const std::size_t index = entryIndex( node, bit );
+  if ( ( node.bitmap & bit ) == 0 )
+  {
+    copy.bitmap |= bit;
+    copy.entries.insert( copy.entries.begin() + index, std::move( leaf ) );
+    isAdded = true;
+    return makeNode( std::move( copy ) );
+  }
+
+  Entry& entry = copy.entries[ index ];
+  if ( entry.child )
+  {
+    entry.child = setEntry( *entry.child, std::move( leaf ), shift + bitsPerLevel, isAdded );
+  }
+  else if ( entry.hash == leaf.hash && entry.key == leaf.key )
+  {
+    entry.value = std::move( leaf.value );
+  }
+  else
+  {
+    // Both keys move down to a new node, which splits them by the next bits of their hashes.
+    Entry existing = std::move( entry );
+    entry = Entry{ existing.hash, SValue( 0 ), SValue( 0 ), makePair( std::move( existing ), std::move( leaf ), shift + bitsPerLevel ) };
+    isAdded = true;
+  }
+  return makeNode( std::move( copy ) );
+}
+
+/// The node without the key. Null if it becomes empty. The node itself if it does not have the key.
+NodePtr eraseEntry( const NodePtr& node, std::size_t hash, const SValue& key, unsigned shift )
+{
+  if ( isCollisionLevel( shift ) )
+  {
+    for ( std::size_t i = 0; i < node->entries.size(); ++i )
+    {
+      if ( node->entries[ i ].key == key )
+      {
+        if ( node->entries.size() == 1 )
+        {
+          return nullptr;
+        }
+        Node copy = *node;
+        copy.entries.erase( copy.entries.begin() + i );
+        return makeNode( std::move( copy ) );
+      }
+    }
+    return node;
+  }
+
+  const std::uint32_t bit = slotBit( hash, shift );
+  if ( ( node->bitmap & bit ) == 0 )
+  {
+    return node;
+  }
+
+  const std::size_t index = entryIndex( *node, bit );
+  const Entry& entry = node->entries[ index ];
+  if ( entry.child )
+  {
+    NodePtr child = eraseEntry( entry.child, hash, key, shift + bitsPerLevel );
+    if ( child == entry.child )
+    {
+      return node;
+    }
+
+    if ( child )
+    {
+      // A child left with a single key is replaced by the key, so lookups stay short.
+      Node copy = *node;
+      const bool isSingleKey = child->entries.size() == 1 && !child->entries.front().child;
+      copy.entries[ index ] = isSingleKey ? child->entries.front() : Entry{ entry.hash, SValue( 0 ), SValue( 0 ), std::move( child ) };
+      return makeNode( std::move( copy ) );
+    }
+  }
+  else if ( entry.hash != hash || !( entry.key == key ) )
+  {
+    return node;
+  }
+
+  if ( node->entries.size() == 1 )
+  {
+    return nullptr;
+  }
+
+  Node copy = *node;
+  copy.bitmap &= ~bit;
+  copy.entries.erase( copy.entries.begin() + index );
+  return makeNode( std::move( copy ) );
+}
+
+void forEachEntry( const Node& node, const std::function< void( const SValue&, const SValue& ) >& f )
+{
+  for ( const Entry& entry : node.entries )
+  {
+    if ( entry.child )
+    {
+      forEachEntry( *entry.child, f );
+    }
+    else
+    {
+      f( entry.key, entry.value );
+    }
+  }
+}
+
+HashMap::HashMap() = default;
+
+bool HashMap::isKey( const SValue& key )
+{
+  return key.isType< Symbol >() || key.isType< int >() || key.isType< std::string >();
+}
+
+std::size_t HashMap::size() const
+{
+  return count;
+}
+
+const SValue* HashMap::find( const SValue& key ) const
+{
+  return root ? findEntry( *root, KeyHash()( key ), key, 0 ) : nullptr;
+}
+
+HashMap HashMap::set( const SValue& key, const SValue& value ) const
+{
+  Entry leaf{ KeyHash()( key ), key, value, nullptr };
+  HashMap updated( *this );
+  if ( !root )
+  {
+    Node node;
+    node.bitmap = slotBit( leaf.hash, 0 );
+    node.entries.push_back( std::move( leaf ) );
+    updated.root = makeNode( std::move( node ) );
+    updated.count = 1;
+    return updated;
+  }
+
+  bool isAdded = false;
+  updated.root = setEntry( *root, std::move( leaf ), 0, isAdded );
+  updated.count += isAdded ? 1 : 0;
+  return updated;
+}
+
+HashMap HashMap::erase( const SValue& key ) const
+{
+  if ( !root )
+  {
+    return *this;
+  }
+
+  HashMap updated( *this );
+  updated.root = eraseEntry( root, KeyHash()( key ), key, 0 );
+  if ( updated.root != root )
+  {
+    --updated.count;
+  }
+  return updated;
+}
+
+void HashMap::forEach( const std::function< void( const SValue& key, const SValue& value ) >& f ) const
+{
+  if ( root )
+  {
+    forEachEntry( *root, f );
+  }
+}
+
+bool HashMap::operator==( const HashMap& other ) const
+{
+  if ( count != other.count )
+  {
+    return false;
+  }
+
+  bool isEqual = true;
+  forEach( [ &other, &isEqual ]( const SValue& key, const SValue& value ) {
+    const SValue* otherValue = other.find( key );
+    isEqual = isEqual && otherValue && *otherValue == value;
+  } );
+  return isEqual;
+}
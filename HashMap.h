@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+class SValue;
+
+/// Hash for the keys of a HashMap. Like SymbolHash, symbols hash by their id.
+struct KeyHash
+{
+  std::size_t operator()( const SValue& key ) const;
+};
+
+/// @brief Persistent hash map from strings, integers, or symbols to values.
+/// It is a hash array mapped trie. Each level uses 5 bits of the key hash to pick one of 32 slots.
+/// Updates copy only the path to the changed entry and share the rest, so the old map stays valid.
+struct HashMap
+{
+  struct Node;
+
+  HashMap();
+
+  /// True if the value can be a key.
+  static bool isKey( const SValue& key );
+
+  std::size_t size() const;
+
+  /// The value for the key. Null if there is none.
+  const SValue* find( const SValue& key ) const;
+
+  /// This map with the key set to the value.
+  HashMap set( const SValue& key, const SValue& value ) const;
+
+  /// This map without the key.
+  HashMap erase( const SValue& key ) const;
+
+  /// Call f with each key and value. The order is that of the key hashes.
+  void forEach( const std::function< void( const SValue& key, const SValue& value ) >& f ) const;
+
+  bool operator==( const HashMap& other ) const;
+
+private:
+  std::shared_ptr< const Node > root;
+  std::size_t count = 0;
+};
@@ -0,0 +1,120 @@
+#include "HashMapOperations.h"
+
+#include "SValue.h"
+
+#include <utility>
+
+SValue* hashMap( SValue* v )
+{
+  Cells& args = v->cellsRequired();
+  REQUIRE( v, args.size() == 1, "hmap requires 1 argument" );
+  REQUIRE( v, args.front()->isQExpression(), "hmap expects a QExpression" );
+
+  HashMap map;
+  for ( const SValue& pair : std::as_const( *args.front() ).get< QExpr >() )
+  {
+    REQUIRE( v, pair.isQExpression() && pair.size() == 2, "hmap expects key value pairs" );
+
+    const QExpr& entry = pair.get< QExpr >();
+    REQUIRE( v, HashMap::isKey( entry.front() ), "hmap keys must be strings, integers, or symbols" );
+    map = map.set( entry.front(), entry.tail().front() );
+  }
+
+  v->value = std::move( map );
+  return v;
+}
+
+/// Replace a quoted symbol key, {k}, with the symbol k. A bare symbol argument is looked up instead.
+void unquoteKey( SValue& key )
+{
+  if ( key.isQExpression() && key.size() == 1 && std::as_const( key ).get< QExpr >().front().isType< Symbol >() )
+  {
+    const Symbol symbol = std::as_const( key ).get< QExpr >().front().get< Symbol >();
+    key.value = symbol;
+  }
+}
+
+/// Check the map and key arguments of the map functions. A quoted symbol key is unquoted.
+/// @return The error message, or null.
+const char* checkMapArguments( Cells& args, std::size_t count, const char* countMessage, const char* typeMessage )
+{
+  if ( args.size() != count )
+  {
+    return countMessage;
+  }
+  if ( count > 1 )
+  {
+    unquoteKey( *args[ 1 ] );
+  }
+  if ( !args[ 0 ]->isType< HashMap >() || ( count > 1 && !HashMap::isKey( *args[ 1 ] ) ) )
+  {
+    return typeMessage;
+  }
+  return nullptr;
+}
+
+SValue* hashMapGet( SValue* v )
+{
+  const char* message = checkMapArguments( v->cellsRequired(), 2, "hget requires 2 arguments", "hget expects a map and a key" );
+  REQUIRE( v, !message, message );
+
+  Cells& args = v->cellsRequired();
+  const SValue* value = std::as_const( *args[ 0 ] ).get< HashMap >().find( *args[ 1 ] );
+  REQUIRE( v, value, "hget key not found" );
+
+  *v = *value;
+  return v;
+}
+
+SValue* hashMapSet( SValue* v )
+{
+  const char* message = checkMapArguments( v->cellsRequired(), 3, "hset requires 3 arguments", "hset expects a map and a key" );
+  REQUIRE( v, !message, message );
+
+  Cells& args = v->cellsRequired();
+  v->value = std::as_const( *args[ 0 ] ).get< HashMap >().set( *args[ 1 ], *args[ 2 ] );
+  return v;
+}
+
+SValue* hashMapDelete( SValue* v )
+{
+  const char* message = checkMapArguments( v->cellsRequired(), 2, "hdel requires 2 arguments", "hdel expects a map and a key" );
+  REQUIRE( v, !message, message );
+
+  Cells& args = v->cellsRequired();
+  v->value = std::as_const( *args[ 0 ] ).get< HashMap >().erase( *args[ 1 ] );
+  return v;
+}
+
+SValue* hashMapHas( SValue* v )
+{
+  const char* message = checkMapArguments( v->cellsRequired(), 2, "hhas requires 2 arguments", "hhas expects a map and a key" );
+  REQUIRE( v, !message, message );
+
+  Cells& args = v->cellsRequired();
+  const bool hasKey = std::as_const( *args[ 0 ] ).get< HashMap >().find( *args[ 1 ] ) != nullptr;
+  v->value = hasKey ? Boolean::True : Boolean::False;
+  return v;
+}
+
+SValue* hashMapKeys( SValue* v )
+{
+  const char* message = checkMapArguments( v->cellsRequired(), 1, "hkeys requires 1 argument", "hkeys expects a map" );
+  REQUIRE( v, !message, message );
+
+  Cells keys;
+  std::as_const( *v->cellsRequired().front() ).get< HashMap >().forEach(
+    [ &keys ]( const SValue& key, const SValue& ) { keys.append( makeSValue( key ) ); } );
+
+  v->value = QExpr( std::move( keys ) );
+  return v;
+}
+
+SValue* hashMapLength( SValue* v )
+{
+  const char* message = checkMapArguments( v->cellsRequired(), 1, "hlen requires 1 argument", "hlen expects a map" );
+  REQUIRE( v, !message, message );
+
+  v->value = static_cast< int >( std::as_const( *v->cellsRequired().front() ).get< HashMap >().size() );
+  return v;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+class SValue;
+
+// The functions that take a key quote symbol keys, like the names given to def. ( hget m {k} )
+
+/// @brief Makes a hash map from a Q-expression of key value pairs. ( hmap {{"a" 1} {"b" 2}} )
+SValue* hashMap( SValue* v );
+
+/// @brief Gets the value for the key. ( hget m k )
+SValue* hashMapGet( SValue* v );
+
+/// @brief Returns the map with the key set to the value. The map passed in is not changed. ( hset m k x )
+SValue* hashMapSet( SValue* v );
+
+/// @brief Returns the map without the key. The map passed in is not changed. ( hdel m k )
+SValue* hashMapDelete( SValue* v );
+
+/// @brief Checks if the map has the key. ( hhas m k )
+SValue* hashMapHas( SValue* v );
+
+/// @brief Gets the keys of the map as a Q-expression. ( hkeys m )
+SValue* hashMapKeys( SValue* v );
+
+/// @brief Gets the number of keys in the map. ( hlen m )
+SValue* hashMapLength( SValue* v );
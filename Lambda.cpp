@@ -1,46 +1,33 @@
-
 #include "Lambda.h"
 #include "SValue.h"
 
 Lambda::Lambda() = default;
 
-Lambda::Lambda( Environment e, std::unique_ptr< SValue > formals, std::unique_ptr< SValue > body )
-: env( std::move( e ) ), formals( std::move( formals ) ), body( std::move( body ) )
+Lambda::Lambda( std::shared_ptr< const SValue > formals, std::shared_ptr< const SValue > body )
+: formals( std::move( formals ) ), body( std::move( body ) )
 {}
 
-Lambda::Lambda( const Lambda& other )
-{
-  *this = other;
-}
+Lambda::Lambda( const Lambda& other ) = default;
+Lambda& Lambda::operator=( const Lambda& other ) = default;
 
-Lambda& Lambda::operator=( const Lambda& other )
-{
-  if ( this != &other )
-  {
-    env = other.env;
-    formals = std::make_unique< SValue >( *other.formals );
-    body = std::make_unique< SValue >( *other.body );
-  }
-  return *this;
-}
+Lambda::Lambda( Lambda&& other ) noexcept = default;
+Lambda& Lambda::operator=( Lambda&& other ) noexcept = default;
 
-Lambda::Lambda( Lambda&& other ) noexcept
+Lambda::~Lambda() = default;
+
+bool Lambda::operator==( const Lambda& other ) const
 {
-  *this = std::move( other );
+  // Closures over different values, or partial applications of different arguments, are different functions.
+  return ( remainingFormals() == other.remainingFormals() ) && ( body == other.body || *body == *other.body ) &&
+         ( arguments == other.arguments ) && ( captures == other.captures ) && ( captured == other.captured );
 }
 
-Lambda& Lambda::operator=( Lambda&& other ) noexcept
+QExpr Lambda::remainingFormals() const
 {
-  if ( this != &other )
+  QExpr remaining = formals->get< QExpr >();
+  for ( std::size_t i = 0; i < arguments.size(); ++i )
   {
-    env = std::move( other.env );
-    formals = std::move( other.formals );
-    body = std::move( other.body );
+    remaining = remaining.tail();
   }
-  return *this;
-}
-
-bool Lambda::operator==( const Lambda& other ) const
-{
-  return ( *formals == *other.formals ) && ( *body == *other.body );
+  return remaining;
 }
@@ -1,17 +1,23 @@
 #pragma once
 
-#include "Environment.h"
+#include "Symbol.h"
 
 #include <memory>
+#include <vector>
 
 class SValue;
+struct Bytecode;
+struct OptimizedBody;
+struct QExpr;
 
 // \  { x y }         {+ x y}
 //    formals qexpr   body qexpr
+/// A lambda captures the free variables of its body that are bound where it is created.
+/// Copies and partial applications share the formals, body, and compiled body.
 struct Lambda
 {
   Lambda();
-  Lambda( Environment e, std::unique_ptr< SValue > formals, std::unique_ptr< SValue > body );
+  Lambda( std::shared_ptr< const SValue > formals, std::shared_ptr< const SValue > body );
 
   Lambda( const Lambda& other );
   Lambda& operator=( const Lambda& other );
@@ -19,9 +25,30 @@ struct Lambda
   Lambda( Lambda&& other ) noexcept;
   Lambda& operator=( Lambda&& other ) noexcept;
 
+  ~Lambda();
+
   bool operator==( const Lambda& other ) const;
 
-  Environment env;
-  std::unique_ptr< SValue > formals;
-  std::unique_ptr< SValue > body;
+  /// The formals that are not bound by partial application.
+  QExpr remainingFormals() const;
+
+  std::shared_ptr< const SValue > formals;
+  std::shared_ptr< const SValue > body;
+
+  /// The captured free variables and their values.
+  std::vector< Symbol > captures;
+  std::vector< SValue > captured;
+
+  /// Arguments bound by partial application, for the first formals.
+  std::vector< SValue > arguments;
+
+  /// The symbols in the formals and body, found on the first call. Null until then.
+  /// A call never looks these up in its callers.
+  mutable std::shared_ptr< const std::vector< Symbol > > names;
+
+  /// The body compiled on the first call. Null until then.
+  mutable std::shared_ptr< const Bytecode > bytecode;
+
+  /// The body rewritten by the optimizer when the lambda is created. Null if it did not change the body.
+  std::shared_ptr< const OptimizedBody > optimized;
 };
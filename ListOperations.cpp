@@ -1,10 +1,16 @@
 
 #include "ListOperations.h"
 #include "Evaluator.h"
+#include "Lambda.h"
+#include "Numeric.h"
+#include "SequenceOperations.h"
 
 #include "SValue.h"
 
 #include <algorithm>
+#include <initializer_list>
+#include <utility>
+#include <vector>
 
 // v is an expression containing { 1 2 3 }
 SValue* head( SValue* v )
@@ -16,13 +22,9 @@ SValue* head( SValue* v )
   REQUIRE( v, qexpr->isQExpression(), "head expects a QExpression" );
   REQUIRE( v, !qexpr->isEmpty(), "head expects a non-empty QExpression" );
 
-  Cells& qexprCells = qexpr->cellsRequired();
-
-  // Take the front only for the Q-expression children.
-  qexprCells.drop( qexprCells.begin() + 1, qexprCells.end() );
-
-  // V becomes Q-expression.
-  std::swap( *v, *qexpr );
+  // V becomes a Q-expression with only the front.
+  QExpr front = QExpr().prepend( qexpr->get< QExpr >().front() );
+  v->value = std::move( front );
   return v;
 }
 
@@ -35,27 +37,16 @@ SValue* tail( SValue* v )
   SValue* qexpr = args.front();
   REQUIRE( v, qexpr->isQExpression(), "tail expects a QExpression" );
 
-  Cells& qexprCells = qexpr->cellsRequired();
-
-  if ( qexprCells.isEmpty() )
-  {
-    v->value = QExpr();
-    return v;
-  }
-
-  // Remove the front.
-  qexprCells.drop( qexprCells.begin() );
-
-  // V becomes Q-expression.
-  //std::swap( *v, *qexpr );
-  v->value = QExpr( std::move( qexprCells ) );
+  // V becomes Q-expression. The rest of the list is shared, not copied.
+  QExpr rest = qexpr->get< QExpr >().tail();
+  v->value = std::move( rest );
   return v;
 }
 
 SValue* list( SValue* v )
 {
   REQUIRE( v, v->isSExpression(), "list expects an S-expression" );
-  v->value = QExpr{ std::move( v->cellsRequired() ) }; // Move the S-expression cells into a Q-expression.
+  v->value = QExpr( std::move( v->cellsRequired() ) ); // Move the S-expression cells into a Q-expression.
   return v;
 }
 
@@ -72,20 +63,15 @@ SValue* join( SValue* v )
 
   REQUIRE( v, allQexprs, "join must take Q-expressions" );
 
-  std::unique_ptr< SValue > joined = cells.takeFront();
-  Cells& joinedCells = joined->cellsRequired();
-
-  // Join rest of the cells.
-  std::for_each( cells.begin(), cells.end(), [ &joinedCells ]( auto& child ) {
-    Cells& otherCells = child->cellsRequired();
-    while ( !otherCells.isEmpty() )
-    {
-      joinedCells.append( otherCells.takeFront() );
-    }
-  } );
+  // Join from the back so the last list is shared instead of copied.
+  QExpr joined;
+  for ( auto it = cells.children().rbegin(); it != cells.children().rend(); ++it )
+  {
+    joined = ( *it )->get< QExpr >().concat( joined );
+  }
 
   // v now becomes a Q-expression.
-  std::swap( *v, *joined );
+  v->value = std::move( joined );
   return v;
 }
 
@@ -97,7 +83,494 @@ SValue* length( SValue* v )
   SValue* qexpr = args.front();
   REQUIRE( v, qexpr->isQExpression(), "length expects a QExpression" );
 
-  Cells& qexprCells = qexpr->cellsRequired();
-  v->value = static_cast< int >( qexprCells.size() );
+  v->value = static_cast< int >( qexpr->size() );
+  return v;
+}
+
+/// Check the argument count of a library function with the formals.
+/// With fewer arguments, v becomes a lambda that takes the rest, as when the function was defined in the library.
+/// e.g. ( map f ) is \ {l} {map f l} with f bound.
+/// @return True if all arguments are passed. Otherwise v holds the lambda or an error.
+bool hasArguments( SValue* v, const char* name, std::initializer_list< const char* > formals )
+{
+  Cells& args = v->cellsRequired();
+  if ( args.size() == formals.size() )
+  {
+    return true;
+  }
+
+  if ( args.size() > formals.size() )
+  {
+    error( v, std::string( name ) + " requires " + std::to_string( formals.size() ) + " arguments" );
+    return false;
+  }
+
+  Cells parameters;
+  Cells call;
+  call.append( makeSValue( Symbol( name ) ) );
+  for ( const char* formal : formals )
+  {
+    parameters.append( makeSValue( Symbol( formal ) ) );
+    call.append( makeSValue( Symbol( formal ) ) );
+  }
+
+  Lambda partial(
+    std::make_shared< const SValue >( QExpr( std::move( parameters ) ) ), std::make_shared< const SValue >( QExpr( std::move( call ) ) ) );
+  for ( std::unique_ptr< SValue >& argument : args.children() )
+  {
+    partial.arguments.push_back( std::move( *argument ) );
+  }
+  v->value = std::move( partial );
+  return false;
+}
+
+/// A Q-expression of the values, in order.
+QExpr makeList( std::vector< SValue >& values )
+{
+  QExpr list;
+  for ( auto it = values.rbegin(); it != values.rend(); ++it )
+  {
+    list = list.prepend( std::move( *it ) );
+  }
+  return list;
+}
+
+SValue* map( Environment& e, SValue* v )
+{
+  if ( !hasArguments( v, "map", { "f", "l" } ) )
+  {
+    return v;
+  }
+
+  Cells& args = v->cellsRequired();
+  if ( const Sequence* s = std::as_const( *args[ 1 ] ).getIf< Sequence >() )
+  {
+    v->value = makeSequence( Sequence::Step::Map, *args[ 0 ], *s );
+    return v;
+  }
+  REQUIRE( v, args[ 1 ]->isQExpression(), "map expects a QExpression or a sequence" );
+
+  std::vector< SValue > results;
+  results.reserve( args[ 1 ]->size() );
+  for ( const SValue& x : std::as_const( *args[ 1 ] ).get< QExpr >() )
+  {
+    results.push_back( call( e, *args[ 0 ], evaluate( e, x ) ) );
+  }
+
+  v->value = makeList( results );
+  return v;
+}
+
+SValue* filter( Environment& e, SValue* v )
+{
+  if ( !hasArguments( v, "filter", { "f", "l" } ) )
+  {
+    return v;
+  }
+
+  Cells& args = v->cellsRequired();
+  if ( const Sequence* s = std::as_const( *args[ 1 ] ).getIf< Sequence >() )
+  {
+    v->value = makeSequence( Sequence::Step::Filter, *args[ 0 ], *s );
+    return v;
+  }
+  REQUIRE( v, args[ 1 ]->isQExpression(), "filter expects a QExpression or a sequence" );
+
+  // The kept elements are not evaluated, only their values are passed to f.
+  std::vector< SValue > kept;
+  for ( const SValue& x : std::as_const( *args[ 1 ] ).get< QExpr >() )
+  {
+    SValue keep = call( e, *args[ 0 ], evaluate( e, x ) );
+    if ( keep.isError() )
+    {
+      *v = std::move( keep );
+      return v;
+    }
+
+    REQUIRE( v, keep.isType< Boolean >(), "filter expects a boolean from the function" );
+    if ( keep.get< Boolean >() == Boolean::True )
+    {
+      kept.push_back( x );
+    }
+  }
+
+  v->value = makeList( kept );
+  return v;
+}
+
+SValue* foldl( Environment& e, SValue* v )
+{
+  if ( !hasArguments( v, "foldl", { "f", "x", "l" } ) )
+  {
+    return v;
+  }
+
+  Cells& args = v->cellsRequired();
+  SValue accumulated = std::move( *args[ 1 ] );
+  if ( const Sequence* s = std::as_const( *args[ 2 ] ).getIf< Sequence >() )
+  {
+    SequenceReader reader( *s );
+    while ( std::optional< SValue > x = reader.next( e ) )
+    {
+      if ( x->isError() )
+      {
+        *v = std::move( *x );
+        return v;
+      }
+      accumulated = call( e, *args[ 0 ], std::move( accumulated ), std::move( *x ) );
+    }
+
+    *v = std::move( accumulated );
+    return v;
+  }
+  REQUIRE( v, args[ 2 ]->isQExpression(), "foldl expects a QExpression or a sequence" );
+
+  for ( const SValue& x : std::as_const( *args[ 2 ] ).get< QExpr >() )
+  {
+    accumulated = call( e, *args[ 0 ], std::move( accumulated ), evaluate( e, x ) );
+  }
+
+  *v = std::move( accumulated );
+  return v;
+}
+
+SValue* scanl( Environment& e, SValue* v )
+{
+  if ( !hasArguments( v, "scanl", { "f", "x", "l" } ) )
+  {
+    return v;
+  }
+
+  Cells& args = v->cellsRequired();
+  REQUIRE( v, args[ 2 ]->isQExpression(), "scanl expects a QExpression" );
+
+  std::vector< SValue > results;
+  results.reserve( args[ 2 ]->size() + 1 );
+  results.push_back( std::move( *args[ 1 ] ) );
+  for ( const SValue& x : std::as_const( *args[ 2 ] ).get< QExpr >() )
+  {
+    results.push_back( call( e, *args[ 0 ], results.back(), evaluate( e, x ) ) );
+  }
+
+  v->value = makeList( results );
+  return v;
+}
+
+SValue* range( Environment&, SValue* v )
+{
+  if ( !hasArguments( v, "range", { "a", "b" } ) )
+  {
+    return v;
+  }
+
+  Cells& args = v->cellsRequired();
+  REQUIRE( v, args[ 0 ]->isType< int >() && args[ 1 ]->isType< int >(), "range expects integers" );
+
+  const int first = args[ 0 ]->get< int >();
+  const int last = args[ 1 ]->get< int >();
+  REQUIRE( v, first <= last, "range expects a start no greater than the end" );
+
+  // Build from the back, the end is included.
+  QExpr list;
+  for ( int i = last;; --i )
+  {
+    list = list.prepend( SValue( i ) );
+    if ( i == first )
+    {
+      break;
+    }
+  }
+
+  v->value = std::move( list );
+  return v;
+}
+
+/// Check the count n and the list or sequence of take, drop and nth.
+/// @return The error message, or null.
+const char* checkCount( const Cells& args, const char* message )
+{
+  if ( !args[ 0 ]->isType< int >() || args[ 0 ]->get< int >() < 0 ||
+       !( args[ 1 ]->isQExpression() || args[ 1 ]->isType< Sequence >() ) )
+  {
+    return message;
+  }
+  return nullptr;
+}
+
+SValue* nth( Environment& e, SValue* v )
+{
+  if ( !hasArguments( v, "nth", { "n", "l" } ) )
+  {
+    return v;
+  }
+
+  Cells& args = v->cellsRequired();
+  const char* message = checkCount( args, "nth expects a non-negative integer and a QExpression or a sequence" );
+  REQUIRE( v, !message, message );
+
+  const std::size_t n = args[ 0 ]->get< int >();
+  if ( const Sequence* s = std::as_const( *args[ 1 ] ).getIf< Sequence >() )
+  {
+    // Only the elements up to the nth are computed.
+    SequenceReader reader( *s );
+    for ( std::size_t i = 0;; ++i )
+    {
+      std::optional< SValue > x = reader.next( e );
+      REQUIRE( v, x, "nth index out of range" );
+      if ( i == n || x->isError() )
+      {
+        *v = std::move( *x );
+        return v;
+      }
+    }
+  }
+
+  const QExpr& l = std::as_const( *args[ 1 ] ).get< QExpr >();
+  REQUIRE( v, n < l.size(), "nth index out of range" );
+
+  *v = evaluate( e, *std::next( l.begin(), n ) );
+  return v;
+}
+
+SValue* last( Environment& e, SValue* v )
+{
+  if ( !hasArguments( v, "last", { "l" } ) )
+  {
+    return v;
+  }
+
+  Cells& args = v->cellsRequired();
+  if ( const Sequence* s = std::as_const( *args[ 0 ] ).getIf< Sequence >() )
+  {
+    SequenceReader reader( *s );
+    std::optional< SValue > previous;
+    while ( std::optional< SValue > x = reader.next( e ) )
+    {
+      previous = std::move( x );
+    }
+    REQUIRE( v, previous, "last expects a non-empty sequence" );
+
+    *v = std::move( *previous );
+    return v;
+  }
+  REQUIRE( v, args[ 0 ]->isQExpression(), "last expects a QExpression or a sequence" );
+
+  const QExpr& l = std::as_const( *args[ 0 ] ).get< QExpr >();
+  REQUIRE( v, !l.isEmpty(), "last expects a non-empty QExpression" );
+
+  *v = evaluate( e, *std::next( l.begin(), l.size() - 1 ) );
+  return v;
+}
+
+SValue* take( Environment&, SValue* v )
+{
+  if ( !hasArguments( v, "take", { "n", "l" } ) )
+  {
+    return v;
+  }
+
+  Cells& args = v->cellsRequired();
+  const char* message = checkCount( args, "take expects a non-negative integer and a QExpression or a sequence" );
+  REQUIRE( v, !message, message );
+
+  if ( const Sequence* s = std::as_const( *args[ 1 ] ).getIf< Sequence >() )
+  {
+    v->value = makeSequence( Sequence::Step::Take, args[ 0 ]->get< int >(), *s );
+    return v;
+  }
+
+  const QExpr& l = std::as_const( *args[ 1 ] ).get< QExpr >();
+  const std::size_t n = args[ 0 ]->get< int >();
+  REQUIRE( v, n <= l.size(), "take expects no more than the length of the list" );
+
+  std::vector< SValue > taken( l.begin(), std::next( l.begin(), n ) );
+  v->value = makeList( taken );
+  return v;
+}
+
+SValue* drop( Environment&, SValue* v )
+{
+  if ( !hasArguments( v, "drop", { "n", "l" } ) )
+  {
+    return v;
+  }
+
+  Cells& args = v->cellsRequired();
+  const char* message = checkCount( args, "drop expects a non-negative integer and a QExpression or a sequence" );
+  REQUIRE( v, !message, message );
+
+  if ( const Sequence* s = std::as_const( *args[ 1 ] ).getIf< Sequence >() )
+  {
+    v->value = makeSequence( Sequence::Step::Drop, args[ 0 ]->get< int >(), *s );
+    return v;
+  }
+
+  // The rest of the list is shared. Dropping more than the length gives the empty list.
+  QExpr rest = std::as_const( *args[ 1 ] ).get< QExpr >();
+  for ( int n = args[ 0 ]->get< int >(); n > 0 && !rest.isEmpty(); --n )
+  {
+    rest = rest.tail();
+  }
+
+  v->value = std::move( rest );
+  return v;
+}
+
+SValue* takeWhile( Environment& e, SValue* v )
+{
+  if ( !hasArguments( v, "takewhile", { "f", "l" } ) )
+  {
+    return v;
+  }
+
+  Cells& args = v->cellsRequired();
+  if ( const Sequence* s = std::as_const( *args[ 1 ] ).getIf< Sequence >() )
+  {
+    v->value = makeSequence( Sequence::Step::TakeWhile, *args[ 0 ], *s );
+    return v;
+  }
+  REQUIRE( v, args[ 1 ]->isQExpression(), "takewhile expects a QExpression or a sequence" );
+
+  // Like filter, the kept elements are not evaluated.
+  std::vector< SValue > taken;
+  for ( const SValue& x : std::as_const( *args[ 1 ] ).get< QExpr >() )
+  {
+    SValue keep = call( e, *args[ 0 ], evaluate( e, x ) );
+    if ( keep.isError() )
+    {
+      *v = std::move( keep );
+      return v;
+    }
+
+    REQUIRE( v, keep.isType< Boolean >(), "takewhile expects a boolean from the function" );
+    if ( keep.get< Boolean >() == Boolean::False )
+    {
+      break;
+    }
+    taken.push_back( x );
+  }
+
+  v->value = makeList( taken );
+  return v;
+}
+
+SValue* iterate( Environment&, SValue* v )
+{
+  if ( !hasArguments( v, "iterate", { "f", "x" } ) )
+  {
+    return v;
+  }
+
+  Cells& args = v->cellsRequired();
+  Sequence s;
+  s.step = Sequence::Step::Iterate;
+  s.function = std::move( *args[ 0 ] );
+  s.start = std::move( *args[ 1 ] );
+  v->value = std::move( s );
+  return v;
+}
+
+/// Fold the list or sequence with the arithmetic operator, like ( foldl + 0 l ).
+/// Integers are combined directly, other values by the built-in operator.
+template < typename Op >
+SValue* accumulate( Environment& e, SValue* v, const char* name, int identity )
+{
+  if ( !hasArguments( v, name, { "l" } ) )
+  {
+    return v;
+  }
+
+  SValue accumulated( identity );
+  auto add = [ &accumulated ]( SValue x ) {
+    if ( accumulated.isType< int >() && x.isType< int >() )
+    {
+      accumulated.value = Op::apply( accumulated.get< int >(), x.get< int >() );
+      return;
+    }
+
+    Cells operands;
+    operands.append( makeSValue( std::move( accumulated ) ) );
+    operands.append( makeSValue( std::move( x ) ) );
+    SValue s( std::move( operands ) );
+    accumulated = std::move( *evaluateNumeric< Op >( &s ) );
+  };
+
+  Cells& args = v->cellsRequired();
+  if ( const Sequence* s = std::as_const( *args[ 0 ] ).getIf< Sequence >() )
+  {
+    SequenceReader reader( *s );
+    while ( std::optional< SValue > x = reader.next( e ) )
+    {
+      if ( x->isError() )
+      {
+        *v = std::move( *x );
+        return v;
+      }
+      add( std::move( *x ) );
+    }
+
+    *v = std::move( accumulated );
+    return v;
+  }
+  REQUIRE( v, args[ 0 ]->isQExpression(), std::string( name ) + " expects a QExpression or a sequence" );
+
+  for ( const SValue& element : std::as_const( *args[ 0 ] ).get< QExpr >() )
+  {
+    add( evaluate( e, element ) );
+  }
+
+  *v = std::move( accumulated );
+  return v;
+}
+
+SValue* sum( Environment& e, SValue* v )
+{
+  return accumulate< Add >( e, v, "sum", 0 );
+}
+
+SValue* product( Environment& e, SValue* v )
+{
+  return accumulate< Multiply >( e, v, "product", 1 );
+}
+
+SValue* elem( Environment& e, SValue* v )
+{
+  if ( !hasArguments( v, "elem", { "x", "l" } ) )
+  {
+    return v;
+  }
+
+  Cells& args = v->cellsRequired();
+  bool isElement = false;
+  if ( const Sequence* s = std::as_const( *args[ 1 ] ).getIf< Sequence >() )
+  {
+    // The sequence is only read up to the element.
+    SequenceReader reader( *s );
+    while ( std::optional< SValue > x = reader.next( e ) )
+    {
+      if ( x->isError() )
+      {
+        *v = std::move( *x );
+        return v;
+      }
+      if ( *x == *args[ 0 ] )
+      {
+        isElement = true;
+        break;
+      }
+    }
+
+    v->value = isElement ? Boolean::True : Boolean::False;
+    return v;
+  }
+  REQUIRE( v, args[ 1 ]->isQExpression(), "elem expects a QExpression or a sequence" );
+
+  // Every element is evaluated, as the fold in the library did.
+  for ( const SValue& element : std::as_const( *args[ 1 ] ).get< QExpr >() )
+  {
+    isElement = ( evaluate( e, element ) == *args[ 0 ] ) || isElement;
+  }
+
+  v->value = isElement ? Boolean::True : Boolean::False;
   return v;
 }
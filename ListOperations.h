@@ -2,6 +2,7 @@
 
 #include <memory>
 
+class Environment;
 class SValue;
 
 /// @brief Take a Q-expression and return the Q-expression with only its first child.
@@ -18,3 +19,50 @@ SValue* join( SValue* v );
 
 /// @brief Gets the length of the Q-expression.
 SValue* length( SValue* v );
+
+// Library list functions. Each runs as a single loop and only calls back into evaluation for the function argument.
+// Elements are evaluated when read, like fst. With fewer arguments, the result is a partial application.
+// They also take sequences. map, filter, take, drop and takewhile then return a sequence that applies
+// them as it is read. The others read the sequence, nth and elem only as far as they need.
+
+/// @brief Apply a function to each element. ( map f l )
+SValue* map( Environment& e, SValue* v );
+
+/// @brief Keep the elements for which the function is true. ( filter f l )
+SValue* filter( Environment& e, SValue* v );
+
+/// @brief Accumulate a value from the left of the list. ( foldl f x l )
+SValue* foldl( Environment& e, SValue* v );
+
+/// @brief Like foldl but returns the list of intermediate values. ( scanl f x l )
+SValue* scanl( Environment& e, SValue* v );
+
+/// @brief The integers from a up to and including b. ( range a b )
+SValue* range( Environment& e, SValue* v );
+
+/// @brief The nth element, counting from 0. ( nth n l )
+SValue* nth( Environment& e, SValue* v );
+
+/// @brief The last element. ( last l )
+SValue* last( Environment& e, SValue* v );
+
+/// @brief The first n elements. ( take n l )
+SValue* take( Environment& e, SValue* v );
+
+/// @brief The list without its first n elements. ( drop n l )
+SValue* drop( Environment& e, SValue* v );
+
+/// @brief The elements before the first for which the function is false. ( takewhile f l )
+SValue* takeWhile( Environment& e, SValue* v );
+
+/// @brief The infinite sequence x, f x, f ( f x ), ... ( iterate f x )
+SValue* iterate( Environment& e, SValue* v );
+
+/// @brief Sum of the elements. ( sum l )
+SValue* sum( Environment& e, SValue* v );
+
+/// @brief Product of the elements. ( product l )
+SValue* product( Environment& e, SValue* v );
+
+/// @brief True if x is an element of the list. ( elem x l )
+SValue* elem( Environment& e, SValue* v );
@@ -0,0 +1,121 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+MappedFile::MappedFile( const std::string& path )
+{
+  file = CreateFileA(
+    path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr );
+  if ( file == INVALID_HANDLE_VALUE )
+  {
+    file = nullptr;
+    return;
+  }
+
+  LARGE_INTEGER fileSize;
+  if ( !GetFileSizeEx( file, &fileSize ) || GetFileType( file ) != FILE_TYPE_DISK )
+  {
+    return;
+  }
+
+  size = static_cast< std::size_t >( fileSize.QuadPart );
+
+  // Empty files cannot be mapped.
+  if ( size == 0 )
+  {
+    opened = true;
+    return;
+  }
+
+  mapping = CreateFileMappingA( file, nullptr, PAGE_READONLY, 0, 0, nullptr );
+  if ( !mapping )
+  {
+    return;
+  }
+
+  data = static_cast< const char* >( MapViewOfFile( mapping, FILE_MAP_READ, 0, 0, 0 ) );
+  opened = data != nullptr;
+}
+
+MappedFile::~MappedFile()
+{
+  if ( data )
+  {
+    UnmapViewOfFile( data );
+  }
+  if ( mapping )
+  {
+    CloseHandle( mapping );
+  }
+  if ( file )
+  {
+    CloseHandle( file );
+  }
+}
+
+#else
+
+MappedFile::MappedFile( const std::string& path )
+{
+  const int fd = ::open( path.c_str(), O_RDONLY );
+  if ( fd < 0 )
+  {
+    return;
+  }
+
+  struct stat info;
+  if ( ::fstat( fd, &info ) == 0 && S_ISREG( info.st_mode ) )
+  {
+    size = static_cast< std::size_t >( info.st_size );
+
+    // Empty files cannot be mapped.
+    if ( size == 0 )
+    {
+      opened = true;
+    }
+    else
+    {
+      void* address = ::mmap( nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0 );
+      if ( address != MAP_FAILED )
+      {
+        ::madvise( address, size, MADV_SEQUENTIAL );
+        data = static_cast< const char* >( address );
+        opened = true;
+      }
+    }
+  }
+
+  // The mapping stays valid after the descriptor is closed.
+  ::close( fd );
+}
+
+MappedFile::~MappedFile()
+{
+  if ( data )
+  {
+    ::munmap( const_cast< char* >( data ), size );
+  }
+}
+
+#endif
+
+bool MappedFile::isOpen() const
+{
+  return opened;
+}
+
+std::string_view MappedFile::contents() const
+{
+  return opened ? std::string_view( data, size ) : std::string_view();
+}
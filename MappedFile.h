@@ -0,0 +1,31 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+/// @brief Read-only memory mapping of a whole file.
+/// The contents are only valid while the MappedFile is alive.
+class MappedFile
+{
+public:
+  explicit MappedFile( const std::string& path );
+  ~MappedFile();
+
+  MappedFile( const MappedFile& ) = delete;
+  MappedFile& operator=( const MappedFile& ) = delete;
+
+  /// False if the file could not be opened or mapped. e.g. Missing files, pipes, or devices.
+  bool isOpen() const;
+
+  std::string_view contents() const;
+
+private:
+  bool opened = false;
+  const char* data = nullptr;
+  std::size_t size = 0;
+
+#ifdef _WIN32
+  void* file = nullptr;
+  void* mapping = nullptr;
+#endif
+};
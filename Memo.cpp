@@ -0,0 +1,120 @@
+#include "Memo.h"
+
+#include "Evaluator.h"
+#include "SValue.h"
+
+#include <list>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+constexpr int defaultCapacity = 1024;
+
+using Arguments = std::vector< SValue >;
+
+struct ArgumentsHash
+{
+  std::size_t operator()( const Arguments& arguments ) const
+  {
+    std::size_t hash = arguments.size();
+    for ( const SValue& argument : arguments )
+    {
+      hash = hash * 31 + hashValue( argument );
+    }
+    return hash;
+  }
+};
+
+struct MemoFunction::Cache
+{
+  using Entries = std::list< std::pair< Arguments, SValue > >;
+
+  SValue function;
+  std::size_t capacity = defaultCapacity;
+  int hits = 0;
+  int misses = 0;
+
+  /// Most recently used first.
+  Entries entries;
+  std::unordered_map< Arguments, Entries::iterator, ArgumentsHash > index;
+};
+
+SValue* MemoFunction::operator()( Environment& e, SValue* v ) const
+{
+  // Calls made by the function may replace this built-in, keep the cache alive until the end.
+  const std::shared_ptr< Cache > current = cache;
+
+  Arguments arguments;
+  for ( const std::unique_ptr< SValue >& argument : v->cellsRequired().children() )
+  {
+    arguments.push_back( *argument );
+  }
+
+  if ( auto it = current->index.find( arguments ); it != current->index.end() )
+  {
+    ++current->hits;
+    current->entries.splice( current->entries.begin(), current->entries, it->second );
+    *v = it->second->second;
+    return v;
+  }
+
+  ++current->misses;
+  Cells call;
+  call.append( makeSValue( current->function ) );
+  for ( std::unique_ptr< SValue >& argument : v->cellsRequired().children() )
+  {
+    call.append( std::move( argument ) );
+  }
+  *v = evaluateSexpr( e, std::move( call ) );
+
+  // Recursive calls may have changed the cache while the result was evaluated, so look it up again.
+  if ( v->isError() || current->index.contains( arguments ) )
+  {
+    return v;
+  }
+
+  if ( current->entries.size() == current->capacity )
+  {
+    current->index.erase( current->entries.back().first );
+    current->entries.pop_back();
+  }
+  current->entries.emplace_front( arguments, *v );
+  current->index.emplace( std::move( arguments ), current->entries.begin() );
+  return v;
+}
+
+SValue* memo( SValue* v )
+{
+  Cells& args = v->cellsRequired();
+  REQUIRE( v, args.size() == 1 || args.size() == 2, "memo expects a lambda and an optional capacity" );
+  REQUIRE( v, args[ 0 ]->isType< Lambda >(), "memo expects a lambda" );
+  REQUIRE( v, args.size() == 1 || ( args[ 1 ]->isType< int >() && args[ 1 ]->get< int >() > 0 ), "memo capacity must be a positive integer" );
+
+  MemoFunction f{ std::make_shared< MemoFunction::Cache >() };
+  f.cache->function = std::move( *args[ 0 ] );
+  if ( args.size() == 2 )
+  {
+    f.cache->capacity = static_cast< std::size_t >( args[ 1 ]->get< int >() );
+  }
+
+  v->value = CoreFunction( std::move( f ) );
+  return v;
+}
+
+SValue* memoStats( SValue* v )
+{
+  Cells& args = v->cellsRequired();
+  const CoreFunction* f = args.size() == 1 ? std::as_const( *args[ 0 ] ).getIf< CoreFunction >() : nullptr;
+  const MemoFunction* memoized = f ? f->target< MemoFunction >() : nullptr;
+  REQUIRE( v, memoized, "memostats expects a memoized function" );
+
+  const MemoFunction::Cache& cache = *memoized->cache;
+  HashMap stats;
+  stats = stats.set( SValue( std::string( "hits" ) ), SValue( cache.hits ) );
+  stats = stats.set( SValue( std::string( "misses" ) ), SValue( cache.misses ) );
+  stats = stats.set( SValue( std::string( "size" ) ), SValue( static_cast< int >( cache.entries.size() ) ) );
+  stats = stats.set( SValue( std::string( "capacity" ) ), SValue( static_cast< int >( cache.capacity ) ) );
+
+  v->value = std::move( stats );
+  return v;
+}
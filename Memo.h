@@ -0,0 +1,24 @@
+#pragma once
+
+#include <memory>
+
+class Environment;
+class SValue;
+
+/// @brief A built-in that caches the results of a lambda by its arguments.
+/// Arguments are compared structurally. When the cache is full, the least recently used result is evicted.
+/// Errors are not cached.
+struct MemoFunction
+{
+  struct Cache;
+
+  SValue* operator()( Environment& e, SValue* v ) const;
+
+  std::shared_ptr< Cache > cache;
+};
+
+/// @brief Makes a memoized function from a lambda. The capacity is optional. ( memo f 1000 )
+SValue* memo( SValue* v );
+
+/// @brief Gets the hits, misses, size, and capacity of a memoized function as a hash map. ( memostats f )
+SValue* memoStats( SValue* v );
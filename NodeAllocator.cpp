@@ -0,0 +1,99 @@
+#include "NodeAllocator.h"
+
+#include <algorithm>
+
+PoolNodeAllocator::~PoolNodeAllocator()
+{
+  while ( chunks )
+  {
+    Chunk* next = chunks->next;
+    ::operator delete( chunks );
+    chunks = next;
+  }
+}
+
+void* PoolNodeAllocator::allocate( std::size_t bytes )
+{
+  if ( bytes > maxPooledSize )
+  {
+    return ::operator new( bytes );
+  }
+
+  const std::size_t sizeClass = ( std::max< std::size_t >( bytes, 1 ) - 1 ) / granularity;
+
+  // Reuse a freed block.
+  if ( FreeBlock* block = freeLists[ sizeClass ] )
+  {
+    freeLists[ sizeClass ] = block->next;
+    return block;
+  }
+
+  // Carve from the current chunk. The remainder of a full chunk is left unused.
+  const std::size_t blockSize = ( sizeClass + 1 ) * granularity;
+  if ( static_cast< std::size_t >( chunkEnd - chunkCursor ) < blockSize )
+  {
+    // The chunk header takes one granule so blocks stay aligned.
+    Chunk* chunk = static_cast< Chunk* >( ::operator new( chunkSize ) );
+    chunk->next = chunks;
+    chunks = chunk;
+    chunkCursor = reinterpret_cast< std::byte* >( chunk ) + granularity;
+    chunkEnd = reinterpret_cast< std::byte* >( chunk ) + chunkSize;
+  }
+
+  void* block = chunkCursor;
+  chunkCursor += blockSize;
+  return block;
+}
+
+void PoolNodeAllocator::deallocate( void* p, std::size_t bytes )
+{
+  if ( bytes > maxPooledSize )
+  {
+    ::operator delete( p );
+    return;
+  }
+
+  const std::size_t sizeClass = ( std::max< std::size_t >( bytes, 1 ) - 1 ) / granularity;
+  FreeBlock* block = static_cast< FreeBlock* >( p );
+  block->next = freeLists[ sizeClass ];
+  freeLists[ sizeClass ] = block;
+}
+
+NodeAllocator*& currentAllocator()
+{
+  // The default allocator is never destroyed, so nodes can still be freed during static destruction.
+  static NodeAllocator* allocator = new PoolNodeAllocator();
+  return allocator;
+}
+
+AllocationCounters counters;
+
+NodeAllocator& nodeAllocator()
+{
+  return *currentAllocator();
+}
+
+void setNodeAllocator( NodeAllocator& allocator )
+{
+  currentAllocator() = &allocator;
+}
+
+void* allocateNode( std::size_t bytes )
+{
+  counters.allocations += 1;
+  counters.bytesAllocated += bytes;
+  counters.bytesInUse += bytes;
+  return currentAllocator()->allocate( bytes );
+}
+
+void deallocateNode( void* p, std::size_t bytes )
+{
+  counters.deallocations += 1;
+  counters.bytesInUse -= bytes;
+  currentAllocator()->deallocate( p, bytes );
+}
+
+const AllocationCounters& allocationCounters()
+{
+  return counters;
+}
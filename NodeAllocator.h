@@ -0,0 +1,105 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+
+/// Counters for all node allocations.
+struct AllocationCounters
+{
+  std::size_t allocations = 0;
+  std::size_t deallocations = 0;
+  std::size_t bytesAllocated = 0;
+  std::size_t bytesInUse = 0;
+};
+
+/// @brief Allocator for interpreter nodes. e.g. SValues, the cells of expressions, and environment bindings.
+/// Implementations can be plugged in with setNodeAllocator.
+/// Not thread safe, the interpreter is single threaded.
+class NodeAllocator
+{
+public:
+  virtual ~NodeAllocator() = default;
+
+  virtual void* allocate( std::size_t bytes ) = 0;
+  virtual void deallocate( void* p, std::size_t bytes ) = 0;
+};
+
+/// @brief Serves small blocks from free lists, one per size class. The lists are refilled from large chunks.
+/// Freed blocks are reused for the same size class. Chunks are kept until the allocator is destroyed.
+class PoolNodeAllocator : public NodeAllocator
+{
+public:
+  PoolNodeAllocator() = default;
+  ~PoolNodeAllocator() override;
+
+  PoolNodeAllocator( const PoolNodeAllocator& ) = delete;
+  PoolNodeAllocator& operator=( const PoolNodeAllocator& ) = delete;
+
+  void* allocate( std::size_t bytes ) override;
+  void deallocate( void* p, std::size_t bytes ) override;
+
+  // Size classes are multiples of the granularity. Larger blocks use the global heap.
+  static constexpr std::size_t granularity = 16;
+  static constexpr std::size_t maxPooledSize = 512;
+  static constexpr std::size_t chunkSize = 64 * 1024;
+
+private:
+  struct FreeBlock
+  {
+    FreeBlock* next;
+  };
+
+  struct Chunk
+  {
+    Chunk* next;
+  };
+
+  static constexpr std::size_t sizeClassCount = maxPooledSize / granularity;
+
+  FreeBlock* freeLists[ sizeClassCount ] = {};
+  Chunk* chunks = nullptr;
+  std::byte* chunkCursor = nullptr;
+  std::byte* chunkEnd = nullptr;
+};
+
+/// The allocator for all nodes. A PoolNodeAllocator unless replaced.
+NodeAllocator& nodeAllocator();
+
+/// Replace the node allocator. Nodes must be freed by the allocator that made them,
+/// so this must be called before any nodes are allocated. The allocator must outlive all nodes.
+void setNodeAllocator( NodeAllocator& allocator );
+
+/// Allocate from the node allocator and update the counters.
+void* allocateNode( std::size_t bytes );
+void deallocateNode( void* p, std::size_t bytes );
+
+const AllocationCounters& allocationCounters();
+
+/// @brief Standard allocator interface for the node allocator. e.g. for std::vector or std::allocate_shared.
+template < typename T >
+struct NodeAllocatorAdapter
+{
+  using value_type = T;
+
+  NodeAllocatorAdapter() = default;
+
+  template < typename U >
+  NodeAllocatorAdapter( const NodeAllocatorAdapter< U >& )
+  {}
+
+  T* allocate( std::size_t n )
+  {
+    return static_cast< T* >( allocateNode( n * sizeof( T ) ) );
+  }
+
+  void deallocate( T* p, std::size_t n )
+  {
+    deallocateNode( p, n * sizeof( T ) );
+  }
+
+  template < typename U >
+  bool operator==( const NodeAllocatorAdapter< U >& ) const
+  {
+    return true;
+  }
+};
@@ -3,9 +3,12 @@
 #include "SValue.h"
 
 #include <algorithm>
+#include <cmath>
 //#include <numeric>
 #include <string>
 #include <type_traits>
+#include <utility>
+#include <vector>
 
 //template < typename Itr >
 //class DataPointerIterator
@@ -32,118 +35,295 @@
 //  }
 //};
 
-// v is an S-expression. e.g. 1 2 3 5
-template < typename NumericT >
-SValue* evaluateNumericT( const std::string& op, SValue* v )
+// Arithmetic operators. Each is a separate type, so every operator and numeric type gets its own instantiation.
+// check returns the error for a right operand, or null. apply combines two operands.
+
+struct Add
 {
-  static_assert(
-    std::is_integral_v< NumericT > || std::is_floating_point_v< NumericT >,
-    "evaluateNumeric must be used with integral or floating point types" );
+  static constexpr const char* name = "+";
 
-  Cells& cells = v->cellsRequired();
+  template < typename NumericT >
+  static const char* check( NumericT )
+  {
+    return nullptr;
+  }
 
-  const bool allNumeric =
-    std::all_of( cells.begin(), cells.end(), []( const auto& s ) { return s->isType< NumericT >(); } );
+  template < typename NumericT >
+  static NumericT apply( NumericT x, NumericT y )
+  {
+    return x + y;
+  }
+};
 
-  REQUIRE( v, allNumeric, op + " Not all arguments are the same numeric type" );
+struct Subtract
+{
+  static constexpr const char* name = "-";
 
-  // Negation
-  if ( op == "-" && cells.size() == 1 )
+  template < typename NumericT >
+  static const char* check( NumericT )
   {
-    SValue* s = cells.front();
-    v->value = apply< NumericT >( s, std::negate< NumericT >() );
-    return v;
+    return nullptr;
   }
 
-  using AccumulatorFunc = std::function< Value( NumericT, NumericT ) >;
+  template < typename NumericT >
+  static NumericT apply( NumericT x, NumericT y )
+  {
+    return x - y;
+  }
+};
+
+struct Multiply
+{
+  static constexpr const char* name = "*";
+
+  template < typename NumericT >
+  static const char* check( NumericT )
+  {
+    return nullptr;
+  }
+
+  template < typename NumericT >
+  static NumericT apply( NumericT x, NumericT y )
+  {
+    return x * y;
+  }
+};
+
+struct Divide
+{
+  static constexpr const char* name = "/";
+
+  template < typename NumericT >
+  static const char* check( NumericT y )
+  {
+    return y == NumericT{ 0 } ? "Division by zero" : nullptr;
+  }
 
-  auto pickAccumulator = [ &op ]() -> AccumulatorFunc {
-    if ( op == "+" )
+  template < typename NumericT >
+  static NumericT apply( NumericT x, NumericT y )
+  {
+    return x / y;
+  }
+};
+
+struct Modulo
+{
+  static constexpr const char* name = "mod";
+
+  template < typename NumericT >
+  static const char* check( NumericT y )
+  {
+    return y == NumericT{ 0 } ? "Modulus division by zero" : nullptr;
+  }
+
+  template < typename NumericT >
+  static NumericT apply( NumericT x, NumericT y )
+  {
+    if constexpr ( std::is_integral_v< NumericT > )
+    {
+      return x % y;
+    }
+    else
     {
-      return []( NumericT x, NumericT y ) -> Value { return x + y; };
+      // Fall back to float mod.
+      return std::fmod( x, y );
     }
-    if ( op == "-" )
+  }
+};
+
+/// True if every cell is a NumericT or an array of them.
+template < typename NumericT >
+bool allOperands( const Cells& cells )
+{
+  return std::all_of( cells.cbegin(), cells.cend(), []( const auto& s ) {
+    return s->template isType< NumericT >() || s->template isType< NumericArray< NumericT > >();
+  } );
+}
+
+/// The error of the operator for the elements, or null.
+template < typename Op, typename NumericT >
+const char* checkElements( const NumericArray< NumericT >& y )
+{
+  const NumericT* end = y.data() + y.size();
+  const NumericT* invalid = std::find_if( y.data(), end, []( NumericT element ) { return Op::check( element ) != nullptr; } );
+  return invalid == end ? nullptr : Op::check( *invalid );
+}
+
+// v is an S-expression of numbers and arrays of them. e.g. #[1 2 3] 10
+// Arrays are combined element by element, and numbers are broadcast over arrays.
+template < typename NumericT, typename Op >
+SValue* evaluateArraysT( SValue* v )
+{
+  Cells& cells = v->cellsRequired();
+
+  // The result is a number until it is combined with an array.
+  NumericT scalar{};
+  std::vector< NumericT > result;
+  bool isArray = false;
+
+  for ( std::size_t i = 0; i < cells.size(); ++i )
+  {
+    const SValue& operand = std::as_const( *cells[ i ] );
+    const NumericArray< NumericT >* y = operand.getIf< NumericArray< NumericT > >();
+    if ( i == 0 )
     {
-      return []( NumericT x, NumericT y ) -> Value { return x - y; };
+      isArray = y != nullptr;
+      if ( isArray )
+      {
+        result = *y->elements;
+      }
+      else
+      {
+        scalar = operand.get< NumericT >();
+      }
+      continue;
     }
-    if ( op == "*" )
+
+    if ( !y )
     {
-      return []( NumericT x, NumericT y ) -> Value { return x * y; };
+      const NumericT value = operand.get< NumericT >();
+      if ( const char* message = Op::check( value ) )
+      {
+        return error( v, message );
+      }
+
+      if ( isArray )
+      {
+        applyKernel< Op >( result.data(), value, result.data(), result.size() );
+      }
+      else
+      {
+        scalar = Op::apply( scalar, value );
+      }
+      continue;
     }
-    if ( op == "/" )
+
+    if ( const char* message = checkElements< Op >( *y ) )
     {
-      return []( NumericT x, NumericT y ) -> Value {
-        return y == 0 ? Value( Error( "Division by zero" ) ) : Value( x / y );
-      };
+      return error( v, message );
     }
-    if ( op == "mod" )
+
+    if ( isArray )
     {
-      return []( NumericT x, NumericT y ) -> Value {
-        if ( y == NumericT{ 0 } )
-        {
-          return Value( Error( "Modulus division by zero" ) );
-        }
-        if constexpr ( std::is_integral_v< NumericT > )
-        {
-          return Value( x % y );
-        }
-        else
-        {
-          // Fall back to float mod.
-          return std::fmod< double >( x, y );
-        }
-      };
+      REQUIRE( v, result.size() == y->size(), std::string( Op::name ) + " Arrays must have the same length" );
+      applyKernel< Op >( result.data(), y->data(), result.data(), result.size() );
     }
-    return []( NumericT x, NumericT y ) -> Value { return Error( "Unsupported numerical operator" ); };
-  };
-
-  //auto integralOperator = [ &op ]() -> AccumulatorFunc {
-  //  if ( op == "+" )
-  //  {
-  //    return []( SValue* x, SValue* y ) -> SValue* { return concat< NumericT >( x, y, std::plus< NumericT >() ); };
-  //  }
-  //  if ( op == "-" )
-  //  {
-  //    return []( SValue* x, SValue* y ) -> SValue* { return concat< NumericT >( x, y, std::minus< NumericT >() ); };
-  //  }
-  //  if ( op == "*" )
-  //  {
-  //    return
-  //      []( SValue* x, SValue* y ) -> SValue* { return concat< NumericT >( x, y, std::multiplies< NumericT >() ); };
-  //  }
-  //  if ( op == "/" )
-  //  {
-  //    return []( SValue* x, SValue* y ) -> SValue* {
-  //      if ( x->isError() )
-  //      {
-  //        return x; // Propagate error.
-  //      }
-
-  //      NumericT yvalue = std::get< NumericT >( y->value );
-  //      REQUIRE( x, yvalue != NumericT{ 0 }, "Division by zero" );
-  //      return concat< NumericT >( x, y, std::divides< NumericT >() );
-  //    };
-  //  }
-
-  //  return []( SValue* x, SValue* ) -> SValue* { return error( x, "Unsupported numerical operator" ); };
-  //};
-
-  //SValue* finalValue = std::accumulate(
-  //  DataPointerIterator( cells.begin() + 1 ), DataPointerIterator( cells.end() ), cells.front(), integralOperator() );
-
-  std::unique_ptr< SValue > first = cells.takeFront();
-  Value result = first->value;
-  auto accumulator = pickAccumulator();
-
-  while ( !cells.isEmpty() )
-  {
-    result = accumulator( std::get< NumericT >( result ), cells.takeFront()->get< NumericT >() );
-    if ( auto error = std::get_if< Error >( &result ) )
+    else
     {
-      break;
+      result.resize( y->size() );
+      applyKernel< Op >( scalar, y->data(), result.data(), result.size() );
+      isArray = true;
     }
   }
 
+  // Negation
+  if constexpr ( std::is_same_v< Op, Subtract > )
+  {
+    if ( cells.size() == 1 )
+    {
+      std::transform( result.begin(), result.end(), result.begin(), []( NumericT x ) { return -x; } );
+    }
+  }
+
+  if ( isArray )
+  {
+    v->value = NumericArray< NumericT >( std::move( result ) );
+  }
+  else
+  {
+    v->value = scalar;
+  }
+  return v;
+}
+
+/// Apply the operator to numbers and arrays of them. All must have the same numeric type.
+template < typename Op >
+SValue* evaluateArrays( SValue* v )
+{
+  const Cells& cells = v->cellsRequired();
+  if ( allOperands< int >( cells ) )
+  {
+    return evaluateArraysT< int, Op >( v );
+  }
+  if ( allOperands< double >( cells ) )
+  {
+    return evaluateArraysT< double, Op >( v );
+  }
+  return error( v, std::string( Op::name ) + " Not all arguments are the same numeric type" );
+}
+
+// v is an S-expression. e.g. 1 2 3 5
+// The result is accumulated unboxed and stored in v once.
+template < typename NumericT, typename Op >
+SValue* evaluateNumericT( SValue* v )
+{
+  static_assert(
+    std::is_integral_v< NumericT > || std::is_floating_point_v< NumericT >,
+    "evaluateNumeric must be used with integral or floating point types" );
+
+  Cells& cells = v->cellsRequired();
+
+  // Common case of two arguments.
+  if ( cells.size() == 2 )
+  {
+    const NumericT* x = std::as_const( *cells[ 0 ] ).getIf< NumericT >();
+    const NumericT* y = std::as_const( *cells[ 1 ] ).getIf< NumericT >();
+    if ( !x || !y )
+    {
+      return evaluateArrays< Op >( v );
+    }
+
+    if ( const char* message = Op::check( *y ) )
+    {
+      return error( v, message );
+    }
+    v->value = Op::apply( *x, *y );
+    return v;
+  }
+
+  const bool allNumeric =
+    std::all_of( cells.begin(), cells.end(), []( const auto& s ) { return s->isType< NumericT >(); } );
+
+  if ( !allNumeric )
+  {
+    return evaluateArrays< Op >( v );
+  }
+
+  // Negation
+  if constexpr ( std::is_same_v< Op, Subtract > )
+  {
+    if ( cells.size() == 1 )
+    {
+      v->value = -std::as_const( *cells.front() ).get< NumericT >();
+      return v;
+    }
+  }
+
+  NumericT result = std::as_const( *cells[ 0 ] ).get< NumericT >();
+  for ( std::size_t i = 1; i < cells.size(); ++i )
+  {
+    const NumericT y = std::as_const( *cells[ i ] ).get< NumericT >();
+    if ( const char* message = Op::check( y ) )
+    {
+      return error( v, message );
+    }
+    result = Op::apply( result, y );
+  }
+
   v->value = result;
   return v;
 }
+
+/// Apply the operator to the numbers in v. The type of the first number is used for all of them.
+template < typename Op >
+SValue* evaluateNumeric( SValue* v )
+{
+  Cells& cells = v->cellsRequired();
+  if ( cells.front()->isType< int >() )
+  {
+    return evaluateNumericT< int, Op >( v );
+  }
+
+  // Fall back to float.
+  return evaluateNumericT< double, Op >( v );
+}
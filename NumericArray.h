@@ -0,0 +1,132 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+/// @brief Packed array of integers or floats. The elements are stored unboxed and contiguous,
+/// so whole array arithmetic runs in simple loops that the compiler vectorizes.
+/// Arrays are immutable. Copies share the elements.
+template < typename NumericT >
+struct NumericArray
+{
+  NumericArray() : elements( std::make_shared< const std::vector< NumericT > >() )
+  {}
+
+  explicit NumericArray( std::vector< NumericT > values )
+    : elements( std::make_shared< const std::vector< NumericT > >( std::move( values ) ) )
+  {}
+
+  std::size_t size() const
+  {
+    return elements->size();
+  }
+
+  const NumericT* data() const
+  {
+    return elements->data();
+  }
+
+  NumericT operator[]( std::size_t index ) const
+  {
+    return ( *elements )[ index ];
+  }
+
+  bool operator==( const NumericArray& other ) const
+  {
+    return *elements == *other.elements;
+  }
+
+  std::shared_ptr< const std::vector< NumericT > > elements;
+};
+
+using IntArray = NumericArray< int >;
+using FloatArray = NumericArray< double >;
+
+// Kernels. They work on blocks of a fixed number of lanes, which the compiler turns into SIMD instructions.
+
+constexpr std::size_t kernelLanes = 8;
+
+/// out[ i ] = element( i ) for each index. Each block is computed before it is stored,
+/// so the block is vectorized even when out is one of the inputs.
+template < typename OutT, typename Element >
+void mapKernel( std::size_t n, OutT* out, Element element )
+{
+  std::size_t i = 0;
+  for ( ; i + kernelLanes <= n; i += kernelLanes )
+  {
+    OutT block[ kernelLanes ];
+    for ( std::size_t lane = 0; lane < kernelLanes; ++lane )
+    {
+      block[ lane ] = element( i + lane );
+    }
+    for ( std::size_t lane = 0; lane < kernelLanes; ++lane )
+    {
+      out[ i + lane ] = block[ lane ];
+    }
+  }
+  for ( ; i < n; ++i )
+  {
+    out[ i ] = element( i );
+  }
+}
+
+/// The element of an operand. A number is the same for every index.
+template < typename NumericT >
+NumericT elementAt( NumericT* elements, std::size_t i )
+{
+  return elements[ i ];
+}
+
+template < typename NumericT >
+NumericT elementAt( NumericT x, std::size_t )
+{
+  return x;
+}
+
+/// out[ i ] = Op::apply( x[ i ], y[ i ] ). Either operand may be a number.
+template < typename Op, typename LeftT, typename RightT, typename NumericT >
+void applyKernel( LeftT x, RightT y, NumericT* out, std::size_t n )
+{
+  mapKernel( n, out, [ x, y ]( std::size_t i ) {
+    return Op::template apply< NumericT >( elementAt( x, i ), elementAt( y, i ) );
+  } );
+}
+
+/// out[ i ] = 1 if CompareOp()( x[ i ], y[ i ] ), otherwise 0. Either operand may be a number.
+template < typename CompareOp, typename LeftT, typename RightT >
+void compareKernel( LeftT x, RightT y, int* out, std::size_t n )
+{
+  mapKernel( n, out, [ x, y ]( std::size_t i ) { return CompareOp()( elementAt( x, i ), elementAt( y, i ) ) ? 1 : 0; } );
+}
+
+/// Fold the elements with combine. The loop keeps independent partial results in lanes,
+/// so it is vectorized for floats too, whose addition is not associative.
+/// The lanes start at initial, which must not change the result. e.g. 0 for a sum.
+template < typename NumericT, typename Combine, typename Element >
+NumericT reduceKernel( std::size_t n, NumericT initial, Combine combine, Element element )
+{
+  NumericT partial[ kernelLanes ];
+  std::fill( partial, partial + kernelLanes, initial );
+
+  std::size_t i = 0;
+  for ( ; i + kernelLanes <= n; i += kernelLanes )
+  {
+    for ( std::size_t lane = 0; lane < kernelLanes; ++lane )
+    {
+      partial[ lane ] = combine( partial[ lane ], element( i + lane ) );
+    }
+  }
+  for ( ; i < n; ++i )
+  {
+    partial[ 0 ] = combine( partial[ 0 ], element( i ) );
+  }
+
+  NumericT result = partial[ 0 ];
+  for ( std::size_t lane = 1; lane < kernelLanes; ++lane )
+  {
+    result = combine( result, partial[ lane ] );
+  }
+  return result;
+}
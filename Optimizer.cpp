@@ -0,0 +1,416 @@
+#include "Optimizer.h"
+
+#include "Evaluator.h"
+
+#include <algorithm>
+#include <iostream>
+#include <optional>
+
+bool isOptimizerEnabled = true;
+bool showOptimizedForms = false;
+
+void setOptimize( bool optimize )
+{
+  isOptimizerEnabled = optimize;
+}
+
+bool useOptimizer()
+{
+  return isOptimizerEnabled;
+}
+
+void setShowOptimizedForms( bool show )
+{
+  showOptimizedForms = show;
+}
+
+/// Built-ins without side effects. Their calls on literals are evaluated when optimizing.
+constexpr const char* pureFunctions[] = { "+", "-",   "*",  "/",  "mod", "<",    "<=",   ">",    ">=", "eq",
+                                          "neq", "and", "or", "not", "head", "tail", "list", "join", "len" };
+
+const Symbol funSymbol( "fun" );
+
+/// Calls of lambdas are only inlined for bodies up to this many values, and up to this depth.
+constexpr std::size_t inlineSizeLimit = 32;
+constexpr std::size_t inlineDepthLimit = 4;
+
+/// Values that evaluate to themselves.
+bool isLiteral( const SValue& v )
+{
+  return v.isType< int >() || v.isType< double >() || v.isType< Boolean >() || v.isType< std::string >() ||
+         v.isQExpression();
+}
+
+bool isBuiltin( const SValue& v, CoreFunctionPtr function )
+{
+  const CoreFunction* callable = v.getIf< CoreFunction >();
+  const CoreFunctionPtr* target = callable ? callable->target< CoreFunctionPtr >() : nullptr;
+  return target && *target == function;
+}
+
+bool isPure( const SValue& v )
+{
+  static const std::vector< CoreFunctionPtr > functions = [] {
+    std::vector< CoreFunctionPtr > pure;
+    for ( const char* name : pureFunctions )
+    {
+      pure.push_back( findCoreFunction( Symbol( name ) )->function );
+    }
+    return pure;
+  }();
+
+  return std::any_of( functions.begin(), functions.end(), [ &v ]( CoreFunctionPtr f ) { return isBuiltin( v, f ); } );
+}
+
+/// Checks for a call with only literal arguments. Forms without one are left as they are.
+bool hasLiteralCall( const SValue& v )
+{
+  std::size_t count = 0;
+  bool isCall = false;
+  bool areLiterals = true;
+  bool isFound = false;
+  v.foreachCell( [ & ]( const SValue& child ) {
+    if ( count++ == 0 )
+    {
+      isCall = child.isType< Symbol >();
+    }
+    else
+    {
+      areLiterals = areLiterals && isLiteral( child );
+    }
+    isFound = isFound || hasLiteralCall( child );
+  } );
+  return isFound || ( isCall && count > 1 && areLiterals );
+}
+
+/// The number of values in the tree.
+std::size_t treeSize( const SValue& v )
+{
+  std::size_t size = 1;
+  v.foreachCell( [ &size ]( const SValue& child ) { size += treeSize( child ); } );
+  return size;
+}
+
+bool containsSymbol( const SValue& v, const Symbol& symbol )
+{
+  if ( const Symbol* s = v.getIf< Symbol >() )
+  {
+    return *s == symbol;
+  }
+
+  bool isFound = false;
+  v.foreachCell( [ &isFound, &symbol ]( const SValue& child ) { isFound = isFound || containsSymbol( child, symbol ); } );
+  return isFound;
+}
+
+/// Add the symbols that def, =, or fun may bind in the tree. Forms are searched inside Q-expressions too,
+/// they may be evaluated later.
+void collectAssigned( const SValue& v, std::vector< Symbol >& symbols )
+{
+  std::vector< const SValue* > children;
+  v.foreachCell( [ &children ]( const SValue& child ) { children.push_back( &child ); } );
+
+  const Symbol* operation = children.size() > 1 ? children[ 0 ]->getIf< Symbol >() : nullptr;
+  if ( operation && ( *operation == defSymbol || *operation == assignSymbol || *operation == funSymbol ) )
+  {
+    children[ 1 ]->foreachCell( [ &symbols ]( const SValue& child ) {
+      if ( const Symbol* symbol = child.getIf< Symbol >() )
+      {
+        symbols.push_back( *symbol );
+      }
+    } );
+  }
+
+  for ( const SValue* child : children )
+  {
+    collectAssigned( *child, symbols );
+  }
+}
+
+/// The S-expression with the cells of the Q-expression.
+SValue toSexpr( const QExpr& list )
+{
+  return SValue( list.toCells() );
+}
+
+/// The Q-expression with the cells of the optimized S-expression. A literal is the only cell.
+SValue toQexpr( SValue v )
+{
+  if ( Cells* cells = v.cells() )
+  {
+    return SValue( QExpr( std::move( *cells ) ) );
+  }
+
+  Cells cells;
+  cells.append( makeSValue( std::move( v ) ) );
+  return SValue( QExpr( std::move( cells ) ) );
+}
+
+class Optimizer
+{
+public:
+  Optimizer( Environment& e, std::vector< Symbol > unbound ) : e( e ), unbound( std::move( unbound ) )
+  {}
+
+  SValue optimize( const SValue& node )
+  {
+    const Cells* cells = node.cells();
+    if ( !cells || cells->isEmpty() )
+    {
+      return node;
+    }
+
+    // The cells of an S-expression are always evaluated before the call, so they are optimized first.
+    std::vector< SValue > optimized;
+    for ( const std::unique_ptr< SValue >& child : cells->children() )
+    {
+      optimized.push_back( optimize( *child ) );
+    }
+
+    // A single cell is its value, it is not called.
+    if ( optimized.size() == 1 )
+    {
+      return isLiteral( optimized.front() ) ? optimized.front() : SValue( toCells( std::move( optimized ) ) );
+    }
+
+    const Symbol* operation = optimized.front().getIf< Symbol >();
+    const SValue* bound = operation ? find( *operation ) : nullptr;
+    const bool areLiterals = std::all_of( optimized.begin() + 1, optimized.end(), isLiteral );
+
+    if ( bound && isBuiltin( *bound, conditionalFunction() ) && optimized.size() == 4 )
+    {
+      return optimizeConditional( *operation, *bound, optimized );
+    }
+
+    if ( bound && areLiterals && isPure( *bound ) )
+    {
+      SValue result = evaluateSexpr( e, toCells( *bound, optimized ) );
+      if ( isLiteral( result ) )
+      {
+        assume( *operation, *bound );
+        return result;
+      }
+    }
+
+    if ( bound && areLiterals && bound->isType< Lambda >() )
+    {
+      if ( std::optional< SValue > result = inlineCall( *operation, *bound, optimized ) )
+      {
+        return std::move( *result );
+      }
+    }
+
+    return SValue( toCells( std::move( optimized ) ) );
+  }
+
+  std::vector< Assumption > assumptions;
+
+private:
+  /// The value bound to the symbol. Null if the form binds it, or it is not bound yet.
+  const SValue* find( const Symbol& symbol ) const
+  {
+    if ( std::find( unbound.begin(), unbound.end(), symbol ) != unbound.end() )
+    {
+      return nullptr;
+    }
+    return e.find( symbol );
+  }
+
+  void assume( const Symbol& symbol, const SValue& value )
+  {
+    const bool isAssumed = std::any_of(
+      assumptions.begin(), assumptions.end(), [ &symbol ]( const Assumption& a ) { return a.symbol == symbol; } );
+    if ( !isAssumed )
+    {
+      assumptions.push_back( Assumption{ symbol, value } );
+    }
+  }
+
+  static CoreFunctionPtr conditionalFunction()
+  {
+    static const CoreFunctionPtr function = findCoreFunction( conditionalSymbol )->function;
+    return function;
+  }
+
+  static Cells toCells( std::vector< SValue > values )
+  {
+    Cells cells;
+    for ( SValue& value : values )
+    {
+      cells.append( makeSValue( std::move( value ) ) );
+    }
+    return cells;
+  }
+
+  static Cells toCells( const SValue& operation, const std::vector< SValue >& values )
+  {
+    Cells cells;
+    cells.append( makeSValue( operation ) );
+    for ( auto it = values.begin() + 1; it != values.end(); ++it )
+    {
+      cells.append( makeSValue( *it ) );
+    }
+    return cells;
+  }
+
+  /// ( if condition {then} {else} ). Only the branch taken is kept for a literal condition.
+  /// Otherwise the branches are optimized, they are evaluated as S-expressions.
+  SValue optimizeConditional( const Symbol& operation, const SValue& bound, std::vector< SValue >& cells )
+  {
+    const QExpr* then = cells[ 2 ].getIf< QExpr >();
+    const QExpr* otherwise = cells[ 3 ].getIf< QExpr >();
+    if ( !then || !otherwise )
+    {
+      return SValue( toCells( std::move( cells ) ) );
+    }
+
+    assume( operation, bound );
+    if ( const Boolean* condition = cells[ 1 ].getIf< Boolean >() )
+    {
+      return optimize( toSexpr( *condition == Boolean::True ? *then : *otherwise ) );
+    }
+
+    cells[ 2 ] = toQexpr( optimize( toSexpr( *then ) ) );
+    cells[ 3 ] = toQexpr( optimize( toSexpr( *otherwise ) ) );
+    return SValue( toCells( std::move( cells ) ) );
+  }
+
+  /// The literal the call of the lambda on literals evaluates to. Null if the body does not fold to a literal.
+  std::optional< SValue > inlineCall( const Symbol& operation, const SValue& bound, const std::vector< SValue >& cells )
+  {
+    const Lambda& l = bound.get< Lambda >();
+    const QExpr& formals = l.formals->get< QExpr >();
+    const bool isInlined = inlineDepth < inlineDepthLimit && l.captures.empty() && l.arguments.empty() &&
+                           formals.size() + 1 == cells.size() && treeSize( *l.body ) <= inlineSizeLimit &&
+                           !containsSymbol( *l.formals, variadicSymbol ) && !containsSymbol( *l.body, operation );
+    if ( !isInlined )
+    {
+      return std::nullopt;
+    }
+
+    std::vector< std::pair< Symbol, const SValue* > > arguments;
+    auto argument = cells.begin() + 1;
+    for ( const SValue& formal : formals )
+    {
+      arguments.emplace_back( formal.get< Symbol >(), &*argument++ );
+    }
+
+    const std::size_t assumed = assumptions.size();
+    ++inlineDepth;
+    SValue result = optimize( substitute( toSexpr( l.body->get< QExpr >() ), arguments ) );
+    --inlineDepth;
+
+    if ( !isLiteral( result ) )
+    {
+      assumptions.erase( assumptions.begin() + assumed, assumptions.end() );
+      return std::nullopt;
+    }
+
+    assume( operation, bound );
+    return result;
+  }
+
+  /// Replace the formals with the arguments where they are evaluated. Those are the cells of S-expressions
+  /// and the branches of if. Other Q-expressions are data and are not changed.
+  static SValue substitute( const SValue& node, const std::vector< std::pair< Symbol, const SValue* > >& arguments )
+  {
+    if ( const Symbol* symbol = node.getIf< Symbol >() )
+    {
+      auto it = std::find_if( arguments.begin(), arguments.end(), [ symbol ]( const auto& a ) { return a.first == *symbol; } );
+      return it != arguments.end() ? *it->second : node;
+    }
+
+    const Cells* cells = node.cells();
+    if ( !cells )
+    {
+      return node;
+    }
+
+    const bool isConditional = cells->size() == 4 && ( *cells )[ 0 ]->isType< Symbol >() &&
+                               ( *cells )[ 0 ]->get< Symbol >() == conditionalSymbol;
+    Cells substituted;
+    for ( std::size_t i = 0; i < cells->size(); ++i )
+    {
+      const SValue& child = *( *cells )[ i ];
+      const QExpr* branch = isConditional && i >= 2 ? child.getIf< QExpr >() : nullptr;
+      substituted.append(
+        makeSValue( branch ? toQexpr( substitute( toSexpr( *branch ), arguments ) ) : substitute( child, arguments ) ) );
+    }
+    return SValue( std::move( substituted ) );
+  }
+
+  Environment& e;
+
+  // Symbols that are bound when the form runs, but not now. e.g. Formals, and symbols the form defines.
+  std::vector< Symbol > unbound;
+
+  std::size_t inlineDepth = 0;
+};
+
+void optimizeForm( Environment& e, SValue& form )
+{
+  if ( !isOptimizerEnabled || !hasLiteralCall( form ) )
+  {
+    return;
+  }
+
+  std::vector< Symbol > assigned;
+  collectAssigned( form, assigned );
+
+  Optimizer optimizer( e, std::move( assigned ) );
+  SValue optimized = optimizer.optimize( form );
+  if ( optimized == form )
+  {
+    return;
+  }
+
+  if ( showOptimizedForms )
+  {
+    show( std::cerr << "before: ", form ) << '\n';
+    show( std::cerr << "after:  ", optimized ) << '\n';
+  }
+  form = std::move( optimized );
+}
+
+void optimizeLambda( Environment& e, Lambda& l )
+{
+  if ( !isOptimizerEnabled || !hasLiteralCall( *l.body ) )
+  {
+    return;
+  }
+
+  std::vector< Symbol > unbound;
+  collectAssigned( *l.body, unbound );
+  l.formals->foreachCell( [ &unbound ]( const SValue& formal ) { unbound.push_back( formal.get< Symbol >() ); } );
+
+  Optimizer optimizer( e, std::move( unbound ) );
+  SValue optimized = toQexpr( optimizer.optimize( toSexpr( l.body->get< QExpr >() ) ) );
+  if ( optimized == *l.body )
+  {
+    return;
+  }
+
+  if ( showOptimizedForms )
+  {
+    show( std::cerr << "before: ", *l.body ) << '\n';
+    show( std::cerr << "after:  ", optimized ) << '\n';
+  }
+  l.optimized =
+    std::make_shared< OptimizedBody >( OptimizedBody{ std::move( optimized ), std::move( optimizer.assumptions ), nullptr } );
+}
+
+bool assumptionsHold( const Environment& e, const std::vector< Assumption >& assumptions )
+{
+  return std::all_of( assumptions.begin(), assumptions.end(), [ &e ]( const Assumption& a ) {
+    const SValue* bound = e.find( a.symbol );
+    if ( !bound )
+    {
+      return false;
+    }
+
+    // Built-ins compare by the function they call.
+    const CoreFunction* callable = a.value.getIf< CoreFunction >();
+    const CoreFunctionPtr* target = callable ? callable->target< CoreFunctionPtr >() : nullptr;
+    return target ? isBuiltin( *bound, *target ) : *bound == a.value;
+  } );
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "SValue.h"
+
+#include <memory>
+#include <vector>
+
+struct Bytecode;
+
+// The optimizer rewrites forms before they are evaluated. It folds calls of pure built-ins on literals,
+// prunes if branches on literal conditions, and inlines calls of small lambdas on literals when the
+// whole body folds to a literal.
+// Names are looked up when the form is optimized, but can be bound to something else when it runs.
+// An optimized lambda body keeps the bindings it assumed and is only used while they all still hold.
+
+/// A binding an optimized form relies on.
+struct Assumption
+{
+  Symbol symbol;
+  SValue value;
+};
+
+/// @brief The optimized body of a lambda.
+struct OptimizedBody
+{
+  SValue body;
+  std::vector< Assumption > assumptions;
+
+  /// The body compiled on the first call. Null until then.
+  mutable std::shared_ptr< const Bytecode > bytecode;
+};
+
+/// Optimize a top-level form that is evaluated next in the environment.
+void optimizeForm( Environment& e, SValue& form );
+
+/// Optimize the body of a lambda created in the environment. l.optimized is set if the body changed.
+void optimizeLambda( Environment& e, Lambda& l );
+
+/// Checks that every assumed binding still holds in the environment.
+bool assumptionsHold( const Environment& e, const std::vector< Assumption >& assumptions );
+
+/// Run the optimizer. On by default.
+void setOptimize( bool optimize );
+bool useOptimizer();
+
+/// Print each form the optimizer changes, before and after, to stderr.
+void setShowOptimizedForms( bool show );
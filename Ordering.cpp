@@ -2,61 +2,120 @@
 #include "Ordering.h"
 #include "SValue.h"
 
+#include <functional>
+#include <utility>
+#include <vector>
+
+/// The elements of an array operand, or the number to broadcast.
+template < typename NumericT >
+const NumericT* arrayOperand( const SValue& s, std::size_t& size, bool& isArray )
+{
+  if ( const NumericArray< NumericT >* array = s.getIf< NumericArray< NumericT > >() )
+  {
+    size = array->size();
+    isArray = true;
+    return array->data();
+  }
+  return s.getIf< NumericT >();
+}
+
+/// Compare numbers and arrays of T element by element. The result is an integer array with 1 where the comparison holds.
 template < typename T, typename CompareOp >
-SValue* evaluateCompare( SValue* v, CompareOp compare )
+SValue* compareArraysT( SValue* v )
 {
-  REQUIRE( v, v->size() == 2, "Expects two arguments" );
+  const Cells& cells = v->cellsRequired();
+  std::size_t leftSize = 0;
+  std::size_t rightSize = 0;
+  bool isLeftArray = false;
+  bool isRightArray = false;
+  const T* left = arrayOperand< T >( *cells[ 0 ], leftSize, isLeftArray );
+  const T* right = arrayOperand< T >( *cells[ 1 ], rightSize, isRightArray );
+  REQUIRE( v, left && right, "Got incorrect type" );
+  REQUIRE( v, !isLeftArray || !isRightArray || leftSize == rightSize, "Arrays must have the same length" );
 
-  Cells& cells = v->cellsRequired();
-  std::unique_ptr< SValue > left = cells.takeFront();
-  REQUIRE( v, left->isType< T >(), "Got incorrect type" );
+  std::vector< int > mask( isLeftArray ? leftSize : rightSize );
+  if ( isLeftArray && isRightArray )
+  {
+    compareKernel< CompareOp >( left, right, mask.data(), mask.size() );
+  }
+  else if ( isLeftArray )
+  {
+    compareKernel< CompareOp >( left, *right, mask.data(), mask.size() );
+  }
+  else
+  {
+    compareKernel< CompareOp >( *left, right, mask.data(), mask.size() );
+  }
+
+  v->value = IntArray( std::move( mask ) );
+  return v;
+}
 
-  std::unique_ptr< SValue > right = cells.takeFront();
-  REQUIRE( v, right->isType< T >(), "Got incorrect type" );
+template < typename CompareOp >
+SValue* compareArrays( SValue* v )
+{
+  const Cells& cells = v->cellsRequired();
+  if ( cells[ 0 ]->isType< int >() || cells[ 0 ]->isType< IntArray >() )
+  {
+    return compareArraysT< int, CompareOp >( v );
+  }
+  return compareArraysT< double, CompareOp >( v );
+}
 
-  v->value = compare( left->get< T >(), right->get< T >() ) ? Boolean::True : Boolean::False;
+template < typename T, typename CompareOp >
+SValue* evaluateCompare( SValue* v )
+{
+  REQUIRE( v, v->size() == 2, "Expects two arguments" );
+
+  const Cells& cells = v->cellsRequired();
+  const T* left = cells[ 0 ]->getIf< T >();
+  const T* right = cells[ 1 ]->getIf< T >();
+  if ( !left || !right )
+  {
+    return compareArrays< CompareOp >( v );
+  }
+
+  v->value = CompareOp()( *left, *right ) ? Boolean::True : Boolean::False;
   return v;
 }
 
 template < typename CompareOp >
-SValue* evalCellsCompare( SValue* v, CompareOp binaryOp )
+SValue* evalCellsCompare( SValue* v )
 {
   Cells& cells = v->cellsRequired();
   if ( cells.front()->isType< int >() )
   {
-    return evaluateCompare< int >( v, binaryOp );
+    return evaluateCompare< int, CompareOp >( v );
   }
-  return evaluateCompare< double >( v, binaryOp );
+  return evaluateCompare< double, CompareOp >( v );
 }
 
 SValue* evalLesser( Environment& e, SValue* v )
 {
-  return evalCellsCompare( v, std::less<>() );
+  return evalCellsCompare< std::less<> >( v );
 }
 
 SValue* evalLesserEqual( Environment& e, SValue* v )
 {
-  return evalCellsCompare( v, std::less_equal<>() );
+  return evalCellsCompare< std::less_equal<> >( v );
 }
 
 SValue* evalGreater( Environment& e, SValue* v )
 {
-  return evalCellsCompare( v, std::greater<>() );
+  return evalCellsCompare< std::greater<> >( v );
 }
 
 SValue* evalGreaterEqual( Environment& e, SValue* v )
 {
-  return evalCellsCompare( v, std::greater_equal<>() );
+  return evalCellsCompare< std::greater_equal<> >( v );
 }
 
 SValue* evalEquality( Environment& e, SValue* v )
 {
-  Cells& cells = v->cellsRequired();
-  std::unique_ptr< SValue > first = cells.takeFront();
-  while ( !cells.isEmpty() )
+  const Cells& cells = v->cellsRequired();
+  for ( std::size_t i = 1; i < cells.size(); ++i )
   {
-    std::unique_ptr< SValue > other = cells.takeFront();
-    const bool isEqual = *first == *other;
+    const bool isEqual = *cells[ 0 ] == *cells[ i ];
     if ( !isEqual )
     {
       v->value = Boolean::False;
@@ -1,91 +1,187 @@
-
 #include "Parser.h"
 #include "SValue.h"
 
-#include <optional>
-#include <regex>
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <iterator>
+#include <memory>
 #include <stack>
+#include <stdexcept>
 #include <string>
+#include <string_view>
+#include <vector>
+
+// The lexer accepts the same tokens as the original regular expressions:
+//
+//   symbol          [a-zA-Z0-9_+\-*\/\\=<>!&]+
+//   integer         -?[0-9]+
+//   float           -?[0-9]+[.][0-9]+    Strict float. 0. and .0 are not supported.
+//   string literal  "(\\.|[^"])*"
+//   comment         ;[^\r\n]*
+//
+// Tokens are tried in the order: float, integer, string literal, symbol.
+// Characters that do not start any token are skipped.
+
+enum CharClass : unsigned char
+{
+  Whitespace = 1 << 0,
+  Digit = 1 << 1,
+  SymbolCharacter = 1 << 2
+};
 
-//const std::regex symbolRegex( "[a-zA-Z0-9_+\\-*\\/\\\\=<>!&]+" );
-const std::regex symbolRegex( R"([a-zA-Z0-9_+\-*\/\\=<>!&]+)" );
-
-const std::regex integerRegex( "-?[0-9]+" );
+constexpr std::array< unsigned char, 256 > makeCharClasses()
+{
+  std::array< unsigned char, 256 > classes{};
 
-/// Strict float regex. Only matches 0.0 format.
-/// 0. and .0 are not supported.
-const std::regex floatRegex( "-?[0-9]+[.][0-9]+" );
+  // Same set as std::isspace in the "C" locale.
+  for ( unsigned char c : { ' ', '\t', '\n', '\v', '\f', '\r' } )
+  {
+    classes[ c ] |= Whitespace;
+  }
 
-const std::regex stringLiteralRegex( R"("(\\.|[^"])*")" );
-//const std::regex stringLiteralRegex( "\"(\\\\.|[^\"])*\"" );
+  for ( unsigned char c = '0'; c <= '9'; ++c )
+  {
+    classes[ c ] |= Digit | SymbolCharacter;
+  }
 
-const std::regex commentRegex( R"(;[^\r\n]*)" );
+  for ( unsigned char c = 'a'; c <= 'z'; ++c )
+  {
+    classes[ c ] |= SymbolCharacter;
+    classes[ c - 'a' + 'A' ] |= SymbolCharacter;
+  }
 
-enum class RegexType
-{
+  for ( unsigned char c : { '_', '+', '-', '*', '/', '\\', '=', '<', '>', '!', '&' } )
+  {
+    classes[ c ] |= SymbolCharacter;
+  }
 
-  Symbol,
-  Integer,
-  Float,
-  StringLiteral,
-  Comment
-};
+  return classes;
+}
 
-// Regex order matters.
-// Try comments first for early ignore.
-// Try float before int. If int is first, then 10.0 will parse as '10' '0' tokens
-// Finally try string literals and symbols.
-const std::vector< std::pair< RegexType, std::regex > > regexes{
-  { RegexType::Comment, commentRegex },
-  { RegexType::Float, floatRegex },
-  { RegexType::Integer, integerRegex },
-  { RegexType::StringLiteral, stringLiteralRegex },
-  { RegexType::Symbol, symbolRegex } };
+constexpr std::array< unsigned char, 256 > charClasses = makeCharClasses();
 
-bool isBool( const std::string& s )
+bool hasClass( char c, CharClass type )
 {
-  return s == "true" || s == "false";
+  return ( charClasses[ static_cast< unsigned char >( c ) ] & type ) != 0;
 }
 
-bool isInteger( const std::string& s )
+bool isWhitespace( char c )
 {
-  return std::regex_match( s, integerRegex );
+  return hasClass( c, Whitespace );
 }
 
-bool isFloat( const std::string& s )
+bool isDigit( char c )
 {
-  return std::regex_match( s, floatRegex );
+  return hasClass( c, Digit );
 }
 
-bool isStringLiteral( const std::string& s )
+bool isSymbolCharacter( char c )
 {
-  return std::regex_match( s, stringLiteralRegex );
+  return hasClass( c, SymbolCharacter );
 }
 
-Value readValue( const std::string& text )
+/// Matches -?[0-9]+ or -?[0-9]+[.][0-9]+ at the start of the range.
+/// @return The end of the number and whether it is a float. The end is begin if there is no number.
+std::pair< const char*, bool > scanNumber( const char* begin, const char* end )
 {
-  if ( isBool( text ) )
+  const char* it = begin;
+  if ( *it == '-' )
   {
-    return Boolean( text == "true" ? Boolean::True : Boolean::False );
+    ++it;
   }
-  else if ( isInteger( text ) )
+
+  const char* digitsBegin = it;
+  it = std::find_if_not( it, end, isDigit );
+  if ( it == digitsBegin )
   {
-    return std::stoi( text );
+    return { begin, false };
   }
-  else if ( isFloat( text ) )
+
+  // Fraction requires at least one digit after the point.
+  if ( it != end && *it == '.' && it + 1 != end && isDigit( it[ 1 ] ) )
   {
-    return std::stod( text );
+    return { std::find_if_not( it + 1, end, isDigit ), true };
   }
-  else if ( isStringLiteral( text ) )
+
+  return { it, false };
+}
+
+/// Matches "(\\.|[^"])*" at the start of the range, which must be a quote.
+/// Escapes are preferred, but like the backtracking regex, an escaped quote can close an otherwise
+/// unterminated literal. The escape '.' does not match line terminators.
+/// Backtracking is only done for the final input, since a later chunk may still close the literal.
+/// @return One past the closing quote, begin if there is no string literal,
+/// or null if more input is needed to decide.
+const char* scanStringLiteral( const char* begin, const char* end, bool isFinal )
+{
+  std::vector< const char* > escapes;
+  const char* it = begin + 1;
+  while ( true )
   {
-    // String literal should already be quoted.
-    // Get the substring excluding the quote at the beginning and end.
-    return std::string( text.cbegin() + 1, text.cend() - 1 );
+    while ( it != end )
+    {
+      const char c = *it;
+      if ( c == '"' )
+      {
+        return it + 1;
+      }
+
+      if ( c == '\\' && it + 1 != end && it[ 1 ] != '\n' && it[ 1 ] != '\r' )
+      {
+        escapes.push_back( it );
+        it += 2;
+      }
+      else
+      {
+        ++it;
+      }
+    }
+
+    if ( !isFinal )
+    {
+      return nullptr;
+    }
+
+    // Unterminated. Retry the latest escape with the backslash as a plain character.
+    if ( escapes.empty() )
+    {
+      return begin;
+    }
+
+    it = escapes.back() + 1;
+    escapes.pop_back();
+  }
+}
+
+template < typename NumericT >
+NumericT readNumber( const char* begin, const char* end )
+{
+  NumericT value{};
+  if ( std::from_chars( begin, end, value ).ec == std::errc::result_out_of_range )
+  {
+    throw std::out_of_range( "Numeric literal out of range: " + std::string( begin, end ) );
+  }
+  return value;
+}
+
+Value readSymbol( const char* begin, const char* end )
+{
+  const std::string_view text( begin, end - begin );
+  if ( text == "true" )
+  {
+    return Boolean::True;
   }
-  else
+  if ( text == "false" )
   {
-    return Symbol( text );
+    return Boolean::False;
   }
+  return Symbol( text );
+}
+
+bool isLineEnd( char c )
+{
+  return c == '\n' || c == '\r';
 }
 
 std::vector< std::string > lineSplitter( const std::string& line )
@@ -121,128 +217,234 @@ std::vector< std::string > lineSplitter( const std::string& line )
   return splits;
 }
 
-template < typename IteratorT >
-std::unique_ptr< SValue > parse( IteratorT begin, IteratorT end )
-{
-  const std::string validSymbolics = "_+-*\\/=<>!&";
+Parser::Parser( FormCallback onForm ) : onForm( std::move( onForm ) )
+{}
 
-  auto isValidSymbol = [ &validSymbolics ]( unsigned char c ) {
-    return std::isalnum( c ) || validSymbolics.find( c ) != std::string::npos;
-  };
+Parser::~Parser() = default;
 
-  auto isParen = []( unsigned char c ) { return c == '(' || c == ')'; };
-  auto isBraces = []( unsigned char c ) { return c == '{' || c == '}'; };
+void Parser::feed( std::string_view chunk )
+{
+  try
+  {
+    // Lex straight from the chunk unless a token from the previous chunk is still incomplete.
+    if ( pending.empty() )
+    {
+      const std::size_t consumed = lex( chunk, false );
+      pending.assign( chunk.substr( consumed ) );
+    }
+    else
+    {
+      pending.append( chunk );
+      const std::size_t consumed = lex( pending, false );
+      pending.erase( 0, consumed );
+    }
+  }
+  catch ( ... )
+  {
+    reset();
+    throw;
+  }
+}
 
-  auto it = begin;
+void Parser::finish()
+{
+  try
+  {
+    lex( pending, true );
+  }
+  catch ( ... )
+  {
+    reset();
+    throw;
+  }
 
-  // Root for the entire program
-  std::unique_ptr< SValue > root = makeDefaultSValue();
+  const bool isBalanced = traversal.empty();
+  reset();
 
-  std::stack< SValue* > traversal;
-  traversal.push( root.get() );
+  if ( !isBalanced )
+  {
+    throw std::runtime_error( "Mismatched parentheses" );
+  }
+}
 
-  auto appendCellOnly = [ &traversal ]( auto&& value ) -> SValue* {
-    SValue* parent = traversal.top();
-    Cells& cells = parent->cellsRequired();
-    cells.append( makeSValue( std::forward< decltype( value ) >( value ) ) );
-    return cells.back();
-  };
+void Parser::reset()
+{
+  form.reset();
+  traversal = {};
+  pending.clear();
+}
 
-  auto appendAndTraverseCell = [ &traversal, &appendCellOnly ]( auto&& value ) {
-    traversal.push( appendCellOnly( std::forward< decltype( value ) >( value ) ) );
-  };
+std::size_t Parser::depth() const
+{
+  return traversal.size();
+}
 
-  auto popCell = [ &traversal ]() -> SValue* {
-    SValue* s = traversal.top();
-    traversal.pop();
-    return s;
-  };
+bool Parser::isComplete() const
+{
+  return traversal.empty() && pending.empty();
+}
+
+std::size_t Parser::lex( std::string_view input, bool isFinal )
+{
+  const char* const begin = input.data();
+  const char* const end = begin + input.size();
+  const char* it = begin;
 
-  while ( it != end )
+  while ( true )
   {
     // Skip all whitespace.
-    it = std::find_if_not( it, end, []( unsigned char c ) { return std::isspace( c ); } );
+    it = std::find_if_not( it, end, isWhitespace );
 
-    if ( it != end )
+    if ( it == end )
     {
-      const unsigned char c = *it;
+      return input.size();
+    }
 
-      // Begin comment.
-      if ( c == ';' )
+    // A token that reaches the end of the input may continue in the next chunk.
+    // It is left unconsumed until more input arrives.
+    const char* const tokenBegin = it;
+    const char c = *it;
+
+    // Comment until the end of the line.
+    if ( c == ';' )
+    {
+      it = std::find_if( it, end, isLineEnd );
+      if ( it == end && !isFinal )
       {
-        std::match_results< IteratorT > stringMatch;
-        if ( std::regex_search( it, end, stringMatch, commentRegex ) )
-        {
-          it += stringMatch.length();
-          continue;
-        }
+        return tokenBegin - begin;
       }
+      continue;
+    }
+
+    if ( c == '(' )
+    {
+      open( false );
+    }
+
+    else if ( c == '{' )
+    {
+      open( true );
+    }
 
-      if ( c == '(' )
+    else if ( c == '}' || c == ')' )
+    {
+      close( c );
+    }
+
+    // Try to match numerics, string literals, or symbols.
+    else if ( auto [ numberEnd, isFloat ] = scanNumber( it, end ); numberEnd != it )
+    {
+      // An integer followed by '.' at the end could still become a float.
+      const bool mayContinue = numberEnd == end || ( !isFloat && *numberEnd == '.' && numberEnd + 1 == end );
+      if ( mayContinue && !isFinal )
       {
-        appendAndTraverseCell( Cells() );
+        return tokenBegin - begin;
       }
 
-      else if ( c == '{' )
+      if ( isFloat )
       {
-        appendAndTraverseCell( QExpr() );
+        append( makeSValue( readNumber< double >( it, numberEnd ) ) );
       }
+      else
+      {
+        append( makeSValue( readNumber< int >( it, numberEnd ) ) );
+      }
+      it = numberEnd;
+      continue;
+    }
 
-      else if ( c == '}' )
+    else if ( c == '"' )
+    {
+      const char* stringEnd = scanStringLiteral( it, end, isFinal );
+      if ( !stringEnd )
       {
-        SValue* s = popCell();
-        if ( traversal.empty() && !s->isQExpression() )
-        {
-          throw std::runtime_error( "Mismatch Q-expression closing brace" );
-        }
+        return tokenBegin - begin;
       }
 
-      else if ( c == ')' )
+      if ( stringEnd != it )
       {
-        SValue* s = popCell();
-        if ( traversal.empty() && !s->isSExpression() )
-        {
-          throw std::runtime_error( "Mismatch S-expression closing brace" );
-        }
+        // Exclude the quote at the beginning and end.
+        append( makeSValue( std::string( it + 1, stringEnd - 1 ) ) );
+        it = stringEnd;
+        continue;
       }
+    }
 
-      // Try to match numerics, symbols, comments, or string literals.
-      else
+    else if ( isSymbolCharacter( c ) )
+    {
+      const char* symbolEnd = std::find_if_not( it, end, isSymbolCharacter );
+      if ( symbolEnd == end && !isFinal )
       {
-        // Get the best matching regex. Ignores comments.
-        using MatchResult = std::pair< std::size_t, std::string >;
-        auto findMatch = []( IteratorT ibegin, IteratorT iend ) -> std::optional< MatchResult > {
-          auto flags = std::regex_constants::match_default | std::regex_constants::match_continuous;
-          for ( const auto& [ type, regex ] : regexes )
-          {
-            std::match_results< IteratorT > match;
-            if ( std::regex_search( ibegin, iend, match, regex, flags ) && type != RegexType::Comment )
-            {
-              return MatchResult{ match.length(), match.str() };
-            }
-          }
-          return std::nullopt;
-        };
-
-        if ( std::optional< MatchResult > result = findMatch( it, end ) )
-        {
-          auto [ size, token ] = *result;
-          appendCellOnly( readValue( std::move( token ) ) );
-          it += size;
-          continue;
-        }
+        return tokenBegin - begin;
       }
 
-      ++it; // next character.
+      append( makeSValue( readSymbol( it, symbolEnd ) ) );
+      it = symbolEnd;
+      continue;
     }
+
+    ++it; // next character.
   }
+}
 
-  if ( traversal.size() != 1 ) // Only Program node should exist at the end.
+void Parser::append( std::unique_ptr< SValue > value )
+{
+  if ( traversal.empty() )
   {
-    throw std::runtime_error( "Mismatched parentheses" );
+    onForm( std::move( value ) );
+    return;
+  }
+
+  traversal.top().expression->cellsRequired().append( std::move( value ) );
+}
+
+void Parser::open( bool isQuoted )
+{
+  if ( traversal.empty() )
+  {
+    form = makeSValue( Cells() );
+    traversal.push( { form.get(), isQuoted } );
+    return;
   }
 
-  popCell();
+  Cells& cells = traversal.top().expression->cellsRequired();
+  cells.append( makeSValue( Cells() ) );
+  traversal.push( { cells.back(), isQuoted } );
+}
+
+void Parser::close( char bracket )
+{
+  if ( traversal.empty() )
+  {
+    throw std::runtime_error(
+      bracket == '}' ? "Mismatch Q-expression closing brace" : "Mismatched parentheses" );
+  }
+
+  const OpenExpression closed = traversal.top();
+  traversal.pop();
+
+  if ( closed.isQuoted )
+  {
+    closed.expression->value = QExpr( std::move( closed.expression->cellsRequired() ) );
+  }
+
+  // The top-level form is complete.
+  if ( traversal.empty() )
+  {
+    onForm( std::move( form ) );
+  }
+}
+
+template < typename IteratorT >
+std::unique_ptr< SValue > parse( IteratorT begin, IteratorT end )
+{
+  // Root for the entire program
+  std::unique_ptr< SValue > root = makeDefaultSValue();
+
+  Parser parser( [ &root ]( std::unique_ptr< SValue > form ) { root->cellsRequired().append( std::move( form ) ); } );
+  parser.feed( std::string_view( std::to_address( begin ), end - begin ) );
+  parser.finish();
+
   return root;
 }
 
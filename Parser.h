@@ -1,9 +1,65 @@
 #pragma once
 
+#include <functional>
 #include <memory>
+#include <stack>
+#include <string>
+#include <string_view>
 
 class SValue;
 
+/// @brief Incremental parser. Input can be fed in chunks of any size, split anywhere.
+/// Each top-level form is passed to the callback as soon as it is complete.
+/// After an exception, the parser is reset and can be reused for new input.
+class Parser
+{
+public:
+  using FormCallback = std::function< void( std::unique_ptr< SValue > ) >;
+
+  explicit Parser( FormCallback onForm );
+  ~Parser();
+
+  /// Parse the next chunk of input. A token at the end of the chunk is held back until it is complete.
+  void feed( std::string_view chunk );
+
+  /// End of input. Parses any held back token. Throws if brackets are left open.
+  void finish();
+
+  /// Discard all open brackets and held back input.
+  void reset();
+
+  /// The number of open brackets.
+  std::size_t depth() const;
+
+  /// No open brackets and no held back input.
+  bool isComplete() const;
+
+private:
+  /// Lex the input and build forms. When not final, an incomplete token at the end is left unconsumed.
+  /// @return The number of characters consumed.
+  std::size_t lex( std::string_view input, bool isFinal );
+
+  void append( std::unique_ptr< SValue > value );
+  void open( bool isQuoted );
+  void close( char bracket );
+
+  FormCallback onForm;
+
+  // A Q-expression is built as an S-expression and becomes a Q-expression when closed.
+  struct OpenExpression
+  {
+    SValue* expression;
+    bool isQuoted;
+  };
+
+  // The top-level form being built and its open brackets.
+  std::unique_ptr< SValue > form;
+  std::stack< OpenExpression > traversal;
+
+  // Unconsumed input from the end of the previous chunk.
+  std::string pending;
+};
+
 /// @brief Parses a string iterable.
 /// @tparam IteratorT Iterable type for strings. e.g. std::string::iterator
 /// @param begin Where to start parsing.
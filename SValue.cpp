@@ -1,4 +1,4 @@
-
+﻿
 #include "SValue.h"
 #include "Traversal.h"
 
@@ -11,9 +11,374 @@ bool Error::operator==( const Error& e ) const
   return message == e.message;
 }
 
+QExpr::QExpr( Cells cells ) : length( cells.size() )
+{
+  // Build from the back so each node can point to the rest of the list.
+  for ( std::size_t i = cells.size(); i > 0; --i )
+  {
+    first = std::allocate_shared< Node >( NodeAllocatorAdapter< Node >(), std::move( *cells[ i - 1 ] ), std::move( first ) );
+  }
+}
+
+QExpr& QExpr::operator=( const QExpr& other )
+{
+  if ( this != &other )
+  {
+    // Hold the nodes of other first, other may be owned by this list.
+    std::shared_ptr< Node > otherFirst = other.first;
+    const std::size_t otherLength = other.length;
+    release();
+    first = std::move( otherFirst );
+    length = otherLength;
+  }
+  return *this;
+}
+
+QExpr::QExpr( QExpr&& other ) noexcept : first( std::move( other.first ) ), length( other.length )
+{
+  other.length = 0;
+}
+
+QExpr& QExpr::operator=( QExpr&& other ) noexcept
+{
+  if ( this != &other )
+  {
+    std::shared_ptr< Node > otherFirst = std::move( other.first );
+    const std::size_t otherLength = other.length;
+    other.length = 0;
+    release();
+    first = std::move( otherFirst );
+    length = otherLength;
+  }
+  return *this;
+}
+
+QExpr::~QExpr()
+{
+  release();
+}
+
+void QExpr::release()
+{
+  while ( first && first.use_count() == 1 )
+  {
+    std::shared_ptr< Node > next = std::move( first->next );
+    first = std::move( next );
+  }
+  first.reset();
+  length = 0;
+}
+
+std::size_t QExpr::size() const
+{
+  return length;
+}
+
+bool QExpr::isEmpty() const
+{
+  return length == 0;
+}
+
+const SValue& QExpr::front() const
+{
+  return first->value;
+}
+
+QExpr QExpr::tail() const
+{
+  QExpr rest;
+  if ( first )
+  {
+    rest.first = first->next;
+    rest.length = length - 1;
+  }
+  return rest;
+}
+
+QExpr QExpr::prepend( SValue v ) const
+{
+  QExpr list;
+  list.first = std::allocate_shared< Node >( NodeAllocatorAdapter< Node >(), std::move( v ), first );
+  list.length = length + 1;
+  return list;
+}
+
+QExpr QExpr::concat( const QExpr& rest ) const
+{
+  if ( isEmpty() )
+  {
+    return rest;
+  }
+
+  if ( rest.isEmpty() )
+  {
+    return *this;
+  }
+
+  std::vector< const SValue* > values;
+  values.reserve( length );
+  for ( const SValue& v : *this )
+  {
+    values.push_back( &v );
+  }
+
+  QExpr list = rest;
+  for ( auto it = values.rbegin(); it != values.rend(); ++it )
+  {
+    list = list.prepend( **it );
+  }
+  return list;
+}
+
+Cells QExpr::toCells() const
+{
+  Cells cells;
+  for ( const SValue& v : *this )
+  {
+    cells.append( std::make_unique< SValue >( v ) );
+  }
+  return cells;
+}
+
+QExpr::Iterator QExpr::begin() const
+{
+  return Iterator( first.get() );
+}
+
+QExpr::Iterator QExpr::end() const
+{
+  return Iterator();
+}
+
 bool QExpr::operator==( const QExpr& e ) const
 {
-  return cells == e.cells;
+  return length == e.length && std::equal( begin(), end(), e.begin() );
+}
+
+// Bits of an index used by each level of the vector trie.
+constexpr unsigned vectorBits = 5;
+constexpr std::size_t vectorMask = ( std::size_t( 1 ) << vectorBits ) - 1;
+
+/// Leaves hold up to 32 elements. The other nodes hold up to 32 children, each full except the last.
+struct Vector::Node
+{
+  std::vector< SValue > values;
+  std::vector< std::shared_ptr< const Node > > children;
+};
+
+using VectorNodePtr = std::shared_ptr< const Vector::Node >;
+
+VectorNodePtr makeVectorNode( Vector::Node node )
+{
+  return std::allocate_shared< Vector::Node >( NodeAllocatorAdapter< Vector::Node >(), std::move( node ) );
+}
+
+/// A new path from a node at the shift down to a leaf holding v.
+VectorNodePtr vectorPath( unsigned shift, SValue v )
+{
+  Vector::Node node;
+  if ( shift == 0 )
+  {
+    node.values.push_back( std::move( v ) );
+  }
+  else
+  {
+    node.children.push_back( vectorPath( shift - vectorBits, std::move( v ) ) );
+  }
+  return makeVectorNode( std::move( node ) );
+}
+
+/// The node with the element at the index set. The path to it is copied, the rest is shared.
+VectorNodePtr setVectorElement( const Vector::Node& node, unsigned shift, std::size_t index, SValue v )
+{
+  Vector::Node copy = node;
+  if ( shift == 0 )
+  {
+    copy.values[ index & vectorMask ] = std::move( v );
+  }
+  else
+  {
+    VectorNodePtr& child = copy.children[ ( index >> shift ) & vectorMask ];
+    child = setVectorElement( *child, shift - vectorBits, index, std::move( v ) );
+  }
+  return makeVectorNode( std::move( copy ) );
+}
+
+/// The node with v added at the index, which is one past its last element. The path to it is copied.
+VectorNodePtr appendVectorElement( const Vector::Node& node, unsigned shift, std::size_t index, SValue v )
+{
+  Vector::Node copy = node;
+  if ( shift == 0 )
+  {
+    copy.values.push_back( std::move( v ) );
+    return makeVectorNode( std::move( copy ) );
+  }
+
+  const std::size_t child = ( index >> shift ) & vectorMask;
+  if ( child < copy.children.size() )
+  {
+    copy.children[ child ] = appendVectorElement( *copy.children[ child ], shift - vectorBits, index, std::move( v ) );
+  }
+  else
+  {
+    copy.children.push_back( vectorPath( shift - vectorBits, std::move( v ) ) );
+  }
+  return makeVectorNode( std::move( copy ) );
+}
+
+Vector::Vector() : root( makeVectorNode( Node() ) )
+{}
+
+Vector::Vector( std::vector< SValue > values ) : count( values.size() ), length( values.size() )
+{
+  // Fill the leaves in order, then group each level into parents until one node is left.
+  std::vector< VectorNodePtr > level;
+  for ( std::size_t i = 0; i < values.size(); i += vectorMask + 1 )
+  {
+    Node leaf;
+    const auto first = values.begin() + i;
+    const auto last = values.begin() + std::min( i + vectorMask + 1, values.size() );
+    leaf.values.assign( std::make_move_iterator( first ), std::make_move_iterator( last ) );
+    level.push_back( makeVectorNode( std::move( leaf ) ) );
+  }
+
+  while ( level.size() > 1 )
+  {
+    std::vector< VectorNodePtr > parents;
+    for ( std::size_t i = 0; i < level.size(); i += vectorMask + 1 )
+    {
+      Node parent;
+      const auto first = level.begin() + i;
+      const auto last = level.begin() + std::min( i + vectorMask + 1, level.size() );
+      parent.children.assign( std::make_move_iterator( first ), std::make_move_iterator( last ) );
+      parents.push_back( makeVectorNode( std::move( parent ) ) );
+    }
+    level = std::move( parents );
+    shift += vectorBits;
+  }
+
+  root = level.empty() ? makeVectorNode( Node() ) : std::move( level.front() );
+}
+
+std::size_t Vector::size() const
+{
+  return length;
+}
+
+const SValue& Vector::operator[]( std::size_t index ) const
+{
+  const std::size_t position = offset + index;
+  const Node* node = root.get();
+  for ( unsigned s = shift; s > 0; s -= vectorBits )
+  {
+    node = node->children[ ( position >> s ) & vectorMask ].get();
+  }
+  return node->values[ position & vectorMask ];
+}
+
+Vector Vector::set( std::size_t index, SValue v ) const
+{
+  Vector updated( *this );
+  updated.root = setVectorElement( *root, shift, offset + index, std::move( v ) );
+  return updated;
+}
+
+Vector Vector::push( SValue v ) const
+{
+  Vector pushed( *this );
+  const std::size_t position = offset + length;
+  if ( position < count )
+  {
+    // Another view already pushed past this one. Its element is replaced in the copy.
+    pushed.root = setVectorElement( *root, shift, position, std::move( v ) );
+  }
+  else if ( count == std::size_t( 1 ) << ( shift + vectorBits ) )
+  {
+    // The trie is full. The new root holds the old root and the path to v.
+    Node node;
+    node.children.push_back( root );
+    node.children.push_back( vectorPath( shift, std::move( v ) ) );
+    pushed.root = makeVectorNode( std::move( node ) );
+    pushed.shift = shift + vectorBits;
+    ++pushed.count;
+  }
+  else
+  {
+    pushed.root = appendVectorElement( *root, shift, position, std::move( v ) );
+    ++pushed.count;
+  }
+  ++pushed.length;
+  return pushed;
+}
+
+Vector Vector::slice( std::size_t begin, std::size_t end ) const
+{
+  Vector view( *this );
+  view.offset = offset + begin;
+  view.length = end - begin;
+  return view;
+}
+
+QExpr Vector::toList() const
+{
+  QExpr list;
+  for ( std::size_t i = length; i > 0; --i )
+  {
+    list = list.prepend( ( *this )[ i - 1 ] );
+  }
+  return list;
+}
+
+Vector::Iterator Vector::begin() const
+{
+  return Iterator( this, 0 );
+}
+
+Vector::Iterator Vector::end() const
+{
+  return Iterator( this, length );
+}
+
+bool Vector::operator==( const Vector& other ) const
+{
+  return length == other.length && std::equal( begin(), end(), other.begin() );
+}
+
+std::size_t Table::rows() const
+{
+  if ( columns.empty() )
+  {
+    return 0;
+  }
+
+  const SValue& column = columns.front();
+  if ( const IntArray* ints = column.getIf< IntArray >() )
+  {
+    return ints->size();
+  }
+  if ( const FloatArray* floats = column.getIf< FloatArray >() )
+  {
+    return floats->size();
+  }
+  return column.get< Vector >().size();
+}
+
+const SValue* Table::column( const std::string& name ) const
+{
+  auto it = std::find( names.begin(), names.end(), name );
+  return it == names.end() ? nullptr : &columns[ it - names.begin() ];
+}
+
+bool Table::operator==( const Table& other ) const
+{
+  return names == other.names && columns == other.columns;
+}
+
+bool Sequence::operator==( const Sequence& other ) const
+{
+  const bool isSameSource = source == other.source || ( source && other.source && *source == *other.source );
+  return step == other.step && function == other.function && start == other.start && first == other.first &&
+         last == other.last && isSameSource;
 }
 
 bool operator==( const CoreFunction& left, const CoreFunction& right )
@@ -39,6 +404,108 @@ SValue* empty( SValue* s )
   return s;
 }
 
+std::size_t hashCombine( std::size_t seed, std::size_t hash )
+{
+  return seed ^ ( hash + static_cast< std::size_t >( 0x9e3779b97f4a7c15ull ) + ( seed << 6 ) + ( seed >> 2 ) );
+}
+
+/// Floats that compare equal hash the same, 0.0 and -0.0 included.
+std::size_t hashFloat( double d )
+{
+  return d == 0.0 ? 0 : std::hash< double >()( d );
+}
+
+template < typename IteratorT, typename HashF >
+std::size_t hashRange( std::size_t seed, IteratorT begin, IteratorT end, HashF hash )
+{
+  for ( ; begin != end; ++begin )
+  {
+    seed = hashCombine( seed, hash( *begin ) );
+  }
+  return seed;
+}
+
+std::size_t hashValue( const SValue& v )
+{
+  const std::size_t seed = static_cast< std::size_t >( v.value.type() );
+  return v.value.visit( [ seed ]( const auto& item ) -> std::size_t {
+    using T = std::decay_t< decltype( item ) >;
+    if constexpr ( std::is_same_v< T, int > || std::is_same_v< T, Boolean > || std::is_same_v< T, std::string > )
+    {
+      return hashCombine( seed, std::hash< T >()( item ) );
+    }
+    else if constexpr ( std::is_same_v< T, double > )
+    {
+      return hashCombine( seed, hashFloat( item ) );
+    }
+    else if constexpr ( std::is_same_v< T, Symbol > )
+    {
+      return hashCombine( seed, SymbolHash()( item ) );
+    }
+    else if constexpr ( std::is_same_v< T, Error > )
+    {
+      return hashCombine( seed, std::hash< std::string >()( item.message ) );
+    }
+    else if constexpr ( std::is_same_v< T, Cells > )
+    {
+      return hashRange( seed, item.cbegin(), item.cend(), []( const auto& child ) { return hashValue( *child ); } );
+    }
+    else if constexpr ( std::is_same_v< T, QExpr > || std::is_same_v< T, Vector > )
+    {
+      return hashRange( seed, item.begin(), item.end(), hashValue );
+    }
+    else if constexpr ( std::is_same_v< T, IntArray > )
+    {
+      return hashRange( seed, item.data(), item.data() + item.size(), std::hash< int >() );
+    }
+    else if constexpr ( std::is_same_v< T, FloatArray > )
+    {
+      return hashRange( seed, item.data(), item.data() + item.size(), hashFloat );
+    }
+    else if constexpr ( std::is_same_v< T, HashMap > )
+    {
+      // Summed so that the order of the entries does not matter.
+      std::size_t entries = 0;
+      item.forEach( [ &entries ]( const SValue& key, const SValue& value ) {
+        entries += hashCombine( hashValue( key ), hashValue( value ) );
+      } );
+      return hashCombine( seed, entries );
+    }
+    else if constexpr ( std::is_same_v< T, Table > )
+    {
+      const std::size_t names = hashRange( seed, item.names.begin(), item.names.end(), std::hash< std::string >() );
+      return hashRange( names, item.columns.begin(), item.columns.end(), hashValue );
+    }
+    else if constexpr ( std::is_same_v< T, Lambda > )
+    {
+      // Lambdas compare by their remaining formals, body, bound arguments and captured values.
+      const QExpr formals = item.remainingFormals();
+      const std::size_t code =
+        hashCombine( hashRange( seed, formals.begin(), formals.end(), hashValue ), hashValue( *item.body ) );
+      const std::size_t arguments = hashRange( code, item.arguments.begin(), item.arguments.end(), hashValue );
+      const std::size_t captures = hashRange( arguments, item.captures.begin(), item.captures.end(), SymbolHash() );
+      return hashRange( captures, item.captured.begin(), item.captured.end(), hashValue );
+    }
+    else if constexpr ( std::is_same_v< T, Sequence > )
+    {
+      // The fields that Sequence::operator== compares, down the chain of sources.
+      std::size_t hash = seed;
+      for ( const Sequence* s = &item; s; s = s->source.get() )
+      {
+        hash = hashCombine( hash, static_cast< std::size_t >( s->step ) );
+        hash = hashCombine( hashCombine( hash, hashValue( s->function ) ), hashValue( s->start ) );
+        hash = hashCombine( hashCombine( hash, std::hash< int >()( s->first ) ), std::hash< int >()( s->last ) );
+      }
+      return hash;
+    }
+    else
+    {
+      // Built-ins compare by identity.
+      return seed;
+    }
+  } );
+}
+
 std::unordered_map< const SValue*, std::size_t > getDepths( const SValue& r )
 {
   std::unordered_map< const SValue*, std::size_t > depths;
@@ -48,7 +515,7 @@ std::unordered_map< const SValue*, std::size_t > getDepths( const SValue& r )
 
 std::ostream& showExpression( std::ostream& o, const SValue& r )
 {
-  r.foreachCell( [ &o, count = r.size(), i = 0 ]( const SValue& child ) mutable {
+  r.foreachCell( [ &o, count = r.size(), i = std::size_t( 0 ) ]( const SValue& child ) mutable {
     show( o, child );
     if ( ++i < count ) o << ' ';
   } );
@@ -97,22 +564,84 @@ std::ostream& operator<<( std::ostream& o, const SValue& r )
   return o;
 }
 
-std::ostream& operator<<( std::ostream& o, const Cells& t )
+std::ostream& operator<<( std::ostream& o, const Cells& )
 {
   return o << "sexpr";
 }
 
-std::ostream& operator<<( std::ostream& o, const QExpr& t )
+std::ostream& operator<<( std::ostream& o, const QExpr& )
 {
   return o << "qexpr";
 }
 
+std::ostream& operator<<( std::ostream& o, const Vector& t )
+{
+  o << '[';
+  for ( std::size_t i = 0; i < t.size(); ++i )
+  {
+    show( o, t[ i ] );
+    if ( i + 1 < t.size() ) o << ' ';
+  }
+  return o << ']';
+}
+
+std::ostream& operator<<( std::ostream& o, const HashMap& t )
+{
+  o << "#{";
+  std::size_t i = 0;
+  t.forEach( [ &o, &i, count = t.size() ]( const SValue& key, const SValue& value ) {
+    show( o, key ) << ' ';
+    show( o, value );
+    if ( ++i < count ) o << ' ';
+  } );
+  return o << '}';
+}
+
+template < typename NumericT >
+std::ostream& showArray( std::ostream& o, const NumericArray< NumericT >& t )
+{
+  o << "#[";
+  for ( std::size_t i = 0; i < t.size(); ++i )
+  {
+    o << t[ i ];
+    if ( i + 1 < t.size() ) o << ' ';
+  }
+  return o << ']';
+}
+
+std::ostream& operator<<( std::ostream& o, const IntArray& t )
+{
+  return showArray( o, t );
+}
+
+std::ostream& operator<<( std::ostream& o, const FloatArray& t )
+{
+  return showArray( o, t );
+}
+
+std::ostream& operator<<( std::ostream& o, const Table& t )
+{
+  o << "#table{";
+  for ( std::size_t i = 0; i < t.columns.size(); ++i )
+  {
+    show( o, SValue( t.names[ i ] ) ) << ' ';
+    show( o, t.columns[ i ] );
+    if ( i + 1 < t.columns.size() ) o << ' ';
+  }
+  return o << '}';
+}
+
+std::ostream& operator<<( std::ostream& o, const Sequence& )
+{
+  return o << "<sequence>";
+}
+
 std::ostream& operator<<( std::ostream& o, const Error& e )
 {
   return o << "Error: " << e.message;
 }
 
-std::ostream& operator<<( std::ostream& o, const CoreFunction& f )
+std::ostream& operator<<( std::ostream& o, const CoreFunction& )
 {
   return o << "<function>";
 }
@@ -120,11 +649,21 @@ std::ostream& operator<<( std::ostream& o, const CoreFunction& f )
 std::ostream& operator<<( std::ostream& o, const Lambda& f )
 {
   o << "\\ ";
-  show( o, *f.formals ) << ' ';
+  show( o, SValue( f.remainingFormals() ) ) << ' ';
   show( o, *f.body );
   return o;
 }
 
+void* SValue::operator new( std::size_t bytes )
+{
+  return allocateNode( bytes );
+}
+
+void SValue::operator delete( void* p, std::size_t bytes )
+{
+  deallocateNode( p, bytes );
+}
+
 bool SValue::isExpressionType() const
 {
   return isSExpression() || isQExpression();
@@ -145,52 +684,26 @@ bool SValue::isError() const
   return isType< Error >();
 }
 
-/// Get the cell children for an S-expression or Q-expression. Null for other types.
+/// Get the cell children for an S-expression. Null for other types.
 
 const Cells* SValue::cells() const
 {
-  if ( auto sexpr = getIf< Cells >() )
-  {
-    return sexpr;
-  }
-
-  else if ( auto qexpr = getIf< QExpr >() )
-  {
-    return &qexpr->cells;
-  }
-
-  return nullptr;
+  return getIf< Cells >();
 }
 
 Cells* SValue::cells()
 {
-  if ( auto sexpr = getIf< Cells >() )
-  {
-    return sexpr;
-  }
-
-  else if ( auto qexpr = getIf< QExpr >() )
-  {
-    return &qexpr->cells;
-  }
-
-  return nullptr;
+  return getIf< Cells >();
 }
 
-// Gets the cells for the given S-expression or Q-expression.
+// Gets the cells for the given S-expression.
 // For other types, an assertion fails.
 
 Cells& SValue::cellsRequired()
 {
-  if ( auto sexpr = getIf< Cells >() )
-  {
-    return *sexpr;
-  }
-
-  // Fall back to Q-expr.
-  auto qexpr = getIf< QExpr >();
-  assert( qexpr != nullptr );
-  return qexpr->cells;
+  auto sexpr = getIf< Cells >();
+  assert( sexpr != nullptr );
+  return *sexpr;
 }
 
 bool SValue::isEmpty() const
@@ -200,8 +713,12 @@ bool SValue::isEmpty() const
 
 std::size_t SValue::size() const
 {
-  const Cells* c = cells();
-  return c ? c->size() : 0;
+  if ( const Cells* c = cells() )
+  {
+    return c->size();
+  }
+  const QExpr* q = getIf< QExpr >();
+  return q ? q->size() : 0;
 }
 
 bool SValue::operator==( const SValue& other ) const
@@ -2,14 +2,18 @@
 
 #include "Cells.h"
 #include "Environment.h"
+#include "HashMap.h"
 #include "Lambda.h"
+#include "NodeAllocator.h"
+#include "NumericArray.h"
 #include "Symbol.h"
+#include "Value.h"
 
 #include <functional>
+#include <iterator>
 #include <memory>
 #include <optional>
 #include <string>
-#include <variant>
 #include <vector>
 
 class SValue;
@@ -21,30 +25,8 @@ struct Error
   bool operator==( const Error& e ) const;
 };
 
-/// A built-in function.
-/// The environment can be modified by the function.
-/// The S-expression can be modified and reduced (evaluated) by the function.
-/// It returns the new, evalauted S-expression.
-using CoreFunction = std::function< SValue*( Environment&, SValue* v ) >;
-
 bool operator==( const CoreFunction& left, const CoreFunction& right );
 
-struct QExpr
-{
-  // Q-expressions contain cells that are not evaluated.
-  Cells cells;
-
-  bool operator==( const QExpr& e ) const;
-};
-
-/// Wrapper for bool type so it works with std::variant.
-/// Using bool in std::variant can cause issues due to implicit conversions.
-enum class Boolean
-{
-  False,
-  True
-};
-
 // Alternative Boolean Wrapper.
 // TODO: Decide to use Wrapper or Enum
 //struct Boolean
@@ -72,24 +54,27 @@ enum class Boolean
 
 std::ostream& operator<<( std::ostream& o, const Boolean other );
 
-using Value = std::variant< Cells, QExpr, CoreFunction, Symbol, Lambda, int, double, Boolean, std::string, Error >;
-
 class SValue
 {
 public:
   Value value;
 
+  // SValues are allocated from the node allocator.
+  static void* operator new( std::size_t bytes );
+  static void operator delete( void* p, std::size_t bytes );
+
   bool isExpressionType() const;
   bool isSExpression() const;
   bool isQExpression() const;
 
   bool isError() const;
 
-  /// Get the cell children for an S-expression or Q-expression. Null for other types.
+  /// Get the cell children for an S-expression. Null for other types.
+  /// Q-expression children are shared and immutable. See QExpr.
   const Cells* cells() const;
   Cells* cells();
 
-  // Gets the cells for the given S-expression or Q-expression.
+  // Gets the cells for the given S-expression.
   // For other types, an assertion fails.
   Cells& cellsRequired();
 
@@ -104,54 +89,46 @@ public:
   template < typename T >
   bool isType() const
   {
-    return std::get_if< T >( &value ) != nullptr;
+    return value.is< T >();
   }
 
   template < typename T >
   auto getIf()
   {
-    return std::get_if< T >( &value );
+    return value.getIf< T >();
   }
 
   template < typename T >
   auto getIf() const
   {
-    return std::get_if< T >( &value );
+    return value.getIf< T >();
   }
 
   template < typename T >
   auto& get()
   {
-    return std::get< T >( value );
+    return value.get< T >();
   }
 
   template < typename T >
   auto& get() const
   {
-    return std::get< T >( value );
+    return value.get< T >();
   }
 
   /// Apply a function on the expression value.
   template < typename T, typename FuncT >
   void apply( FuncT f )
   {
-    value = f( std::get< T >( value ) );
+    value = f( value.get< T >() );
   }
 
   /// Apply a function for each child. const SValue& is passed to the function.
   template < typename ApplyF >
-  void foreachCell( ApplyF f ) const
-  {
-    if ( const Cells* c = cells() )
-    {
-      for ( const auto& child : c->children() )
-      {
-        f( *child );
-      }
-    }
-  }
+  void foreachCell( ApplyF f ) const;
 
-  /// Apply a function for each child. SValue& is passed to the function.
+  /// Apply a function for each child of an S-expression. SValue& is passed to the function.
+  /// Q-expression children are immutable and are not visited.
   template < typename ApplyF >
   void foreachCell( ApplyF f )
   {
@@ -165,10 +142,267 @@ public:
   }
 };
 
+/// @brief Q-expressions are persistent lists. Their cells are not evaluated.
+/// Cells are immutable once in a list and are shared between lists,
+/// so copying a list, taking its tail, and adding to its front are constant time.
+struct QExpr
+{
+  struct Node
+  {
+    Node( SValue value, std::shared_ptr< Node > next ) : value( std::move( value ) ), next( std::move( next ) )
+    {}
+
+    SValue value;
+    std::shared_ptr< Node > next;
+  };
+
+  class Iterator
+  {
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = SValue;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const SValue*;
+    using reference = const SValue&;
+
+    Iterator() = default;
+
+    explicit Iterator( const Node* node ) : node( node )
+    {}
+
+    const SValue& operator*() const
+    {
+      return node->value;
+    }
+
+    const SValue* operator->() const
+    {
+      return &node->value;
+    }
+
+    Iterator& operator++()
+    {
+      node = node->next.get();
+      return *this;
+    }
+
+    Iterator operator++( int )
+    {
+      Iterator previous = *this;
+      ++*this;
+      return previous;
+    }
+
+    bool operator==( const Iterator& other ) const = default;
+
+  private:
+    const Node* node = nullptr;
+  };
+
+  QExpr() = default;
+
+  /// Moves the cells into a new list.
+  explicit QExpr( Cells cells );
+
+  QExpr( const QExpr& other ) = default;
+  QExpr& operator=( const QExpr& other );
+
+  QExpr( QExpr&& other ) noexcept;
+  QExpr& operator=( QExpr&& other ) noexcept;
+
+  ~QExpr();
+
+  std::size_t size() const;
+  bool isEmpty() const;
+
+  const SValue& front() const;
+
+  /// The list without its first cell. Shares the cells with this list.
+  QExpr tail() const;
+
+  /// The list with a cell added to the front. Shares the cells with this list.
+  QExpr prepend( SValue v ) const;
+
+  /// This list followed by rest. Copies the cells of this list and shares the cells of rest.
+  QExpr concat( const QExpr& rest ) const;
+
+  /// Copies the cells so they can be evaluated.
+  Cells toCells() const;
+
+  Iterator begin() const;
+  Iterator end() const;
+
+  bool operator==( const QExpr& e ) const;
+
+private:
+  /// Release the nodes that are not shared, one at a time.
+  /// Releasing them recursively would overflow the stack on long lists.
+  void release();
+
+  std::shared_ptr< Node > first;
+  std::size_t length = 0;
+};
+
+/// @brief Vectors are random access arrays. The elements are stored in a trie with 32 children per node,
+/// so a lookup takes a few steps even for millions of elements. The nodes are never changed.
+/// Setting or pushing an element copies only the path to it, and shares the rest with this vector.
+/// A vector is a view of a range of its trie. Copies and slices share the trie.
+struct Vector
+{
+  struct Node;
+
+  class Iterator
+  {
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = SValue;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const SValue*;
+    using reference = const SValue&;
+
+    Iterator() = default;
+
+    Iterator( const Vector* vector, std::size_t index ) : vector( vector ), index( index )
+    {}
+
+    const SValue& operator*() const
+    {
+      return ( *vector )[ index ];
+    }
+
+    const SValue* operator->() const
+    {
+      return &( *vector )[ index ];
+    }
+
+    Iterator& operator++()
+    {
+      ++index;
+      return *this;
+    }
+
+    Iterator operator++( int )
+    {
+      Iterator previous = *this;
+      ++*this;
+      return previous;
+    }
+
+    bool operator==( const Iterator& other ) const = default;
+
+  private:
+    const Vector* vector = nullptr;
+    std::size_t index = 0;
+  };
+
+  Vector();
+
+  /// Moves the values into a new trie.
+  explicit Vector( std::vector< SValue > values );
+
+  std::size_t size() const;
+
+  const SValue& operator[]( std::size_t index ) const;
+
+  /// This vector with the element at the index set to v.
+  Vector set( std::size_t index, SValue v ) const;
+
+  /// This vector with v added to the end.
+  Vector push( SValue v ) const;
+
+  /// The elements from begin up to end. Shares the trie with this vector.
+  Vector slice( std::size_t begin, std::size_t end ) const;
+
+  /// Copies the elements into a list.
+  QExpr toList() const;
+
+  Iterator begin() const;
+  Iterator end() const;
+
+  bool operator==( const Vector& other ) const;
+
+private:
+  std::shared_ptr< const Node > root;
+
+  // The number of elements in the trie, and the shift of an index for the children of the root.
+  // The leaves are at shift 0.
+  std::size_t count = 0;
+  unsigned shift = 0;
+
+  std::size_t offset = 0;
+  std::size_t length = 0;
+};
+
+/// @brief Columnar table. Each column has a name and one value per row, stored contiguously
+/// in an IntArray, a FloatArray, or a Vector for other values. e.g. strings.
+/// Tables share their columns, so selecting columns does not copy them.
+struct Table
+{
+  std::size_t rows() const;
+
+  /// The column with the name. Null if there is none.
+  const SValue* column( const std::string& name ) const;
+
+  bool operator==( const Table& other ) const;
+
+  std::vector< std::string > names;
+  std::vector< SValue > columns;
+};
+
+/// @brief Lazy sequence. Elements are computed as the sequence is read, and again each time it is read,
+/// so reading a long or infinite sequence only holds the current element.
+/// A sequence is a source, or a step applied to the elements of another sequence. See SequenceReader.
+struct Sequence
+{
+  enum class Step : std::uint8_t
+  {
+    Range, // The integers from first up to and including last.
+    Iterate, // start, f start, f ( f start ), ...
+    List, // The elements of the Q-expression start.
+    Map,
+    Filter,
+    Take, // The first first elements.
+    TakeWhile,
+    Drop // Without the first first elements.
+  };
+
+  bool operator==( const Sequence& other ) const;
+
+  Step step = Step::List;
+
+  /// The function of Iterate, Map, Filter and TakeWhile.
+  SValue function;
+  SValue start;
+  int first = 0;
+  int last = 0;
+
+  /// The sequence that the step applies to. Null for sources.
+  std::shared_ptr< const Sequence > source;
+};
+
+template < typename ApplyF >
+void SValue::foreachCell( ApplyF f ) const
+{
+  if ( const Cells* c = cells() )
+  {
+    for ( const auto& child : c->children() )
+    {
+      f( *child );
+    }
+  }
+  else if ( const QExpr* q = getIf< QExpr >() )
+  {
+    for ( const SValue& child : *q )
+    {
+      f( child );
+    }
+  }
+}
+
 template < typename T, typename ConcatF >
 SValue* concat( SValue* left, SValue* right, ConcatF concatFunc )
 {
-  left->value = concatFunc( std::get< T >( left->value ), std::get< T >( right->value ) );
+  left->value = concatFunc( left->value.get< T >(), right->value.get< T >() );
   return left;
 }
 
@@ -187,9 +421,20 @@ SValue* empty( SValue* s );
 template < typename T, typename ApplyF >
 Value apply( SValue* s, ApplyF f )
 {
-  return f( std::get< T >( s->value ) );
+  return f( s->value.get< T >() );
 }
 
+/// @brief Structural hash of the value. Values that are equal by operator== have the same hash.
+std::size_t hashValue( const SValue& v );
+
+struct ValueHash
+{
+  std::size_t operator()( const SValue& v ) const
+  {
+    return hashValue( v );
+  }
+};
+
 std::unordered_map< const SValue*, std::size_t > getDepths( const SValue& r );
 
 /// @brief Show the SValue as an expression string.
@@ -199,17 +444,16 @@ std::ostream& show( std::ostream& o, const SValue& r );
 std::ostream& operator<<( std::ostream& o, const SValue& r );
 std::ostream& operator<<( std::ostream& o, const Cells& t );
 std::ostream& operator<<( std::ostream& o, const QExpr& t );
+std::ostream& operator<<( std::ostream& o, const Vector& t );
+std::ostream& operator<<( std::ostream& o, const HashMap& t );
+std::ostream& operator<<( std::ostream& o, const IntArray& t );
+std::ostream& operator<<( std::ostream& o, const FloatArray& t );
+std::ostream& operator<<( std::ostream& o, const Table& t );
+std::ostream& operator<<( std::ostream& o, const Sequence& s );
 std::ostream& operator<<( std::ostream& o, const Error& e );
 std::ostream& operator<<( std::ostream& o, const CoreFunction& f );
 std::ostream& operator<<( std::ostream& o, const Lambda& f );
 
-template < typename... Args >
-std::ostream& operator<<( std::ostream& o, const std::variant< Args... >& value )
-{
-  std::visit( [ &o ]( const auto& item ) { o << item; }, value );
-  return o;
-}
-
 /// Requires that the condition is satisfied.
 /// If not then an Error is returned.
 /// Usage: REQUIRE( !value->isEmpty(), "Must not be empty" );
@@ -0,0 +1,127 @@
+#include "ScriptCache.h"
+#include "MappedFile.h"
+#include "SValue.h"
+#include "slisp.h"
+
+#include <cstdlib>
+#include <filesystem>
+#include <sstream>
+
+// Cache file layout:
+//   magic, format version, interpreter version, source size, source hash, forms size, forms hash, forms
+// Forms are serialized back to back until the end of the file.
+constexpr std::string_view cacheMagic = "SLISPC";
+constexpr std::uint64_t cacheFormatVersion = 1;
+
+/// The directory for the cache files of the user. Empty if there is none.
+std::filesystem::path cacheDirectory()
+{
+  if ( const char* cache = std::getenv( "XDG_CACHE_HOME" ); cache && *cache )
+  {
+    return std::filesystem::path( cache ) / "slisp";
+  }
+  if ( const char* home = std::getenv( "HOME" ); home && *home )
+  {
+    return std::filesystem::path( home ) / ".cache" / "slisp";
+  }
+  if ( const char* local = std::getenv( "LOCALAPPDATA" ); local && *local )
+  {
+    return std::filesystem::path( local ) / "slisp";
+  }
+  return {};
+}
+
+/// The cache file for the script. Scripts with the same name in different directories have different files.
+std::string cachePath( const std::string& scriptPath )
+{
+  const std::filesystem::path directory = cacheDirectory();
+  if ( directory.empty() )
+  {
+    return {};
+  }
+
+  std::error_code error;
+  const std::filesystem::path script = std::filesystem::absolute( scriptPath, error );
+  std::ostringstream name;
+  name << script.stem().string() << '-' << std::hex << hashBytes( script.string() ) << ".slispc";
+  return ( directory / name.str() ).string();
+}
+
+ScriptCache::ScriptCache( const std::string& scriptPath, std::string_view source )
+: path( cachePath( scriptPath ) ), sourceHash( hashBytes( source ) ), sourceSize( source.size() )
+{}
+
+bool ScriptCache::load( const std::function< void( std::unique_ptr< SValue > ) >& f ) const
+{
+  if ( path.empty() )
+  {
+    return false;
+  }
+
+  MappedFile cache( path );
+  if ( !cache.isOpen() )
+  {
+    return false;
+  }
+
+  std::string_view formBytes;
+  try
+  {
+    BinaryReader reader( cache.contents() );
+    if ( reader.readString() != cacheMagic ) return false;
+    if ( reader.readVarint() != cacheFormatVersion ) return false;
+    if ( reader.readString() != interpreterVersion ) return false;
+    if ( reader.readVarint() != sourceSize ) return false;
+    if ( reader.readVarint() != sourceHash ) return false;
+
+    const std::uint64_t formsSize = reader.readVarint();
+    const std::uint64_t formsHash = reader.readVarint();
+
+    // The forms are the rest of the file. Check them before anything is evaluated.
+    formBytes = reader.remaining();
+    if ( formBytes.size() != formsSize || hashBytes( formBytes ) != formsHash ) return false;
+  }
+  catch ( const std::exception& )
+  {
+    return false;
+  }
+
+  BinaryReader reader( formBytes );
+  while ( !reader.isEnd() )
+  {
+    f( deserialize( reader ) );
+  }
+  return true;
+}
+
+void ScriptCache::add( const SValue& form )
+{
+  serialize( forms, form );
+}
+
+bool ScriptCache::save() const
+{
+  if ( path.empty() )
+  {
+    return false;
+  }
+
+  std::error_code error;
+  std::filesystem::create_directories( std::filesystem::path( path ).parent_path(), error );
+  if ( error )
+  {
+    return false;
+  }
+
+  BinaryWriter header;
+  header.writeString( cacheMagic );
+  header.writeVarint( cacheFormatVersion );
+  header.writeString( interpreterVersion );
+  header.writeVarint( sourceSize );
+  header.writeVarint( sourceHash );
+  header.writeVarint( forms.bytes().size() );
+  header.writeVarint( hashBytes( forms.bytes() ) );
+
+  // Concurrent processes never see a partial cache.
+  return writeFileAtomically( path, header.bytes(), forms.bytes() );
+}
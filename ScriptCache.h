@@ -0,0 +1,37 @@
+#pragma once
+
+#include "Serializer.h"
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+
+class SValue;
+
+/// @brief Precompiled AST cache for a script. e.g. standard/Standard.slisp is cached in Standard-<path hash>.slispc
+/// The cache files are kept in the user's cache directory, not next to the scripts. e.g. ~/.cache/slisp
+/// The cache is keyed by the interpreter version and a hash of the source. A stale cache is never used.
+class ScriptCache
+{
+public:
+  ScriptCache( const std::string& scriptPath, std::string_view source );
+
+  /// Pass each cached top-level form to f, in order.
+  /// @return False if there is no valid cache. Then nothing is passed to f.
+  bool load( const std::function< void( std::unique_ptr< SValue > ) >& f ) const;
+
+  /// Record a parsed top-level form. It must be added before evaluation, which modifies it.
+  void add( const SValue& form );
+
+  /// Write the added forms to the cache file.
+  /// @return False if it could not be written. e.g. There is no cache directory.
+  bool save() const;
+
+private:
+  std::string path;
+  std::uint64_t sourceHash = 0;
+  std::uint64_t sourceSize = 0;
+  BinaryWriter forms;
+};
@@ -0,0 +1,238 @@
+#include "SequenceOperations.h"
+
+#include "Evaluator.h"
+
+#include <utility>
+
+SequenceReader::SequenceReader( const Sequence& s )
+  : sequence( s ), source( s.source ? std::make_unique< SequenceReader >( *s.source ) : nullptr )
+{
+  switch ( sequence.step )
+  {
+  case Sequence::Step::Range:
+  case Sequence::Step::Take:
+  case Sequence::Step::Drop:
+    position = sequence.first;
+    break;
+  default:
+    current = sequence.start;
+    break;
+  }
+}
+
+std::optional< SValue > SequenceReader::finish( SValue last )
+{
+  isDone = true;
+  return last;
+}
+
+/// Call the predicate of a step on the element. The result is a boolean or an error.
+SValue test( Environment& e, const SValue& f, const SValue& x, const char* name )
+{
+  SValue result = call( e, f, x );
+  if ( !result.isError() && !result.isType< Boolean >() )
+  {
+    return SValue( Error{ std::string( name ) + " expects a boolean from the function" } );
+  }
+  return result;
+}
+
+std::optional< SValue > SequenceReader::next( Environment& e )
+{
+  if ( isDone )
+  {
+    return std::nullopt;
+  }
+
+  switch ( sequence.step )
+  {
+  case Sequence::Step::Range:
+    if ( position > sequence.last )
+    {
+      isDone = true;
+      return std::nullopt;
+    }
+    return SValue( static_cast< int >( position++ ) );
+
+  case Sequence::Step::Iterate:
+    // f is only called for the elements that are read.
+    if ( isStarted )
+    {
+      current = call( e, sequence.function, std::move( current ) );
+      if ( current.isError() )
+      {
+        return finish( current );
+      }
+    }
+    isStarted = true;
+    return current;
+
+  case Sequence::Step::List:
+  {
+    const QExpr& rest = std::as_const( current ).get< QExpr >();
+    if ( rest.isEmpty() )
+    {
+      isDone = true;
+      return std::nullopt;
+    }
+
+    // Elements are evaluated when read, as map does.
+    SValue x = evaluate( e, rest.front() );
+    current = SValue( rest.tail() );
+    return x;
+  }
+
+  case Sequence::Step::Map:
+  {
+    std::optional< SValue > x = source->next( e );
+    if ( !x || x->isError() )
+    {
+      isDone = true;
+      return x;
+    }
+
+    SValue result = call( e, sequence.function, std::move( *x ) );
+    return result.isError() ? finish( std::move( result ) ) : result;
+  }
+
+  case Sequence::Step::Filter:
+    while ( std::optional< SValue > x = source->next( e ) )
+    {
+      if ( x->isError() )
+      {
+        return finish( std::move( *x ) );
+      }
+
+      SValue keep = test( e, sequence.function, *x, "filter" );
+      if ( keep.isError() )
+      {
+        return finish( std::move( keep ) );
+      }
+      if ( keep.get< Boolean >() == Boolean::True )
+      {
+        return x;
+      }
+    }
+    isDone = true;
+    return std::nullopt;
+
+  case Sequence::Step::Take:
+    // The source is not read past the elements taken, so taking from an infinite sequence ends.
+    if ( position == 0 )
+    {
+      isDone = true;
+      return std::nullopt;
+    }
+    --position;
+    return source->next( e );
+
+  case Sequence::Step::TakeWhile:
+  {
+    std::optional< SValue > x = source->next( e );
+    if ( !x || x->isError() )
+    {
+      isDone = true;
+      return x;
+    }
+
+    SValue keep = test( e, sequence.function, *x, "takewhile" );
+    if ( keep.isError() )
+    {
+      return finish( std::move( keep ) );
+    }
+    if ( keep.get< Boolean >() == Boolean::False )
+    {
+      isDone = true;
+      return std::nullopt;
+    }
+    return x;
+  }
+
+  case Sequence::Step::Drop:
+    for ( ; position > 0; --position )
+    {
+      std::optional< SValue > x = source->next( e );
+      if ( !x || x->isError() )
+      {
+        isDone = true;
+        return x;
+      }
+    }
+    return source->next( e );
+  }
+
+  return std::nullopt;
+}
+
+Sequence makeSequence( Sequence::Step step, const SValue& function, const Sequence& source )
+{
+  Sequence s;
+  s.step = step;
+  s.function = function;
+  s.source = std::make_shared< const Sequence >( source );
+  return s;
+}
+
+Sequence makeSequence( Sequence::Step step, int n, const Sequence& source )
+{
+  Sequence s;
+  s.step = step;
+  s.first = n;
+  s.source = std::make_shared< const Sequence >( source );
+  return s;
+}
+
+SValue* lazy( SValue* v )
+{
+  Cells& args = v->cellsRequired();
+  REQUIRE( v, args.size() == 1 && args.front()->isQExpression(), "lazy expects a QExpression" );
+
+  Sequence s;
+  s.step = Sequence::Step::List;
+  s.start = std::move( *args.front() );
+  v->value = std::move( s );
+  return v;
+}
+
+SValue* lazyRange( SValue* v )
+{
+  Cells& args = v->cellsRequired();
+  REQUIRE( v, args.size() == 2, "lrange requires 2 arguments" );
+  REQUIRE( v, args[ 0 ]->isType< int >() && args[ 1 ]->isType< int >(), "lrange expects integers" );
+
+  Sequence s;
+  s.step = Sequence::Step::Range;
+  s.first = args[ 0 ]->get< int >();
+  s.last = args[ 1 ]->get< int >();
+  REQUIRE( v, s.first <= s.last, "lrange expects a start no greater than the end" );
+
+  v->value = std::move( s );
+  return v;
+}
+
+SValue* collect( Environment& e, SValue* v )
+{
+  Cells& args = v->cellsRequired();
+  REQUIRE( v, args.size() == 1 && args.front()->isType< Sequence >(), "collect expects a sequence" );
+
+  // Build from the back once all elements are read.
+  std::vector< SValue > elements;
+  SequenceReader reader( std::as_const( *args.front() ).get< Sequence >() );
+  while ( std::optional< SValue > x = reader.next( e ) )
+  {
+    if ( x->isError() )
+    {
+      *v = std::move( *x );
+      return v;
+    }
+    elements.push_back( std::move( *x ) );
+  }
+
+  QExpr list;
+  for ( auto it = elements.rbegin(); it != elements.rend(); ++it )
+  {
+    list = list.prepend( std::move( *it ) );
+  }
+  v->value = std::move( list );
+  return v;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "SValue.h"
+
+#include <memory>
+#include <optional>
+
+class Environment;
+
+/// @brief Reads the elements of a sequence in order. The sequence must outlive the reader.
+class SequenceReader
+{
+public:
+  explicit SequenceReader( const Sequence& s );
+
+  /// The next element. Null at the end.
+  /// An error from a function ends the sequence, the error is returned as its last element.
+  std::optional< SValue > next( Environment& e );
+
+private:
+  /// End the sequence with the value. e.g. an error.
+  std::optional< SValue > finish( SValue last );
+
+  const Sequence& sequence;
+  std::unique_ptr< SequenceReader > source;
+
+  // Range: the next integer. Take and Drop: the elements left to take or drop.
+  long long position = 0;
+
+  // Iterate: the last element. List: the rest of the Q-expression.
+  SValue current;
+  bool isStarted = false;
+  bool isDone = false;
+};
+
+/// A sequence that applies the step with the function to the source.
+Sequence makeSequence( Sequence::Step step, const SValue& function, const Sequence& source );
+
+/// A sequence of the first n elements, or of the elements after them.
+Sequence makeSequence( Sequence::Step step, int n, const Sequence& source );
+
+/// @brief Makes a sequence of the elements of a Q-expression. ( lazy {1 2 3} )
+SValue* lazy( SValue* v );
+
+/// @brief The integers from a up to and including b, as a sequence. ( lrange a b )
+SValue* lazyRange( SValue* v );
+
+/// @brief Reads all elements of a sequence into a Q-expression. ( collect s )
+SValue* collect( Environment& e, SValue* v );
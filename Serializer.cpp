@@ -0,0 +1,542 @@
+#include "Serializer.h"
+#include "Evaluator.h"
+#include "Optimizer.h"
+#include "SValue.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <stdexcept>
+
+// Tags for the value types in the binary format.
+// New tags must be appended so existing data keeps its meaning.
+enum class ValueTag : std::uint8_t
+{
+  SExpression,
+  QExpression,
+  Symbol,
+  Integer,
+  Float,
+  False,
+  True,
+  String,
+  Error,
+  Lambda,
+  CoreFunction,
+  Vector,
+  HashMap,
+  IntArray,
+  FloatArray,
+  Table,
+  Sequence
+};
+
+void BinaryWriter::writeByte( std::uint8_t b )
+{
+  buffer.push_back( static_cast< char >( b ) );
+}
+
+void BinaryWriter::writeVarint( std::uint64_t n )
+{
+  // 7 bits per byte. The high bit marks that more bytes follow.
+  while ( n >= 0x80 )
+  {
+    writeByte( static_cast< std::uint8_t >( n | 0x80 ) );
+    n >>= 7;
+  }
+  writeByte( static_cast< std::uint8_t >( n ) );
+}
+
+void BinaryWriter::writeInt( std::int64_t n )
+{
+  // Zigzag encoding so small negative numbers stay small.
+  writeVarint( ( static_cast< std::uint64_t >( n ) << 1 ) ^ static_cast< std::uint64_t >( n >> 63 ) );
+}
+
+void BinaryWriter::writeDouble( double d )
+{
+  char bytes[ sizeof( double ) ];
+  std::memcpy( bytes, &d, sizeof( double ) );
+  buffer.append( bytes, sizeof( double ) );
+}
+
+void BinaryWriter::writeString( std::string_view s )
+{
+  writeVarint( s.size() );
+  buffer.append( s );
+}
+
+const std::string& BinaryWriter::bytes() const
+{
+  return buffer;
+}
+
+BinaryReader::BinaryReader( std::string_view bytes ) : bytes( bytes )
+{}
+
+std::uint8_t BinaryReader::readByte()
+{
+  if ( position >= bytes.size() )
+  {
+    throw std::runtime_error( "Unexpected end of binary data" );
+  }
+  return static_cast< std::uint8_t >( bytes[ position++ ] );
+}
+
+std::uint64_t BinaryReader::readVarint()
+{
+  std::uint64_t n = 0;
+  for ( unsigned shift = 0; shift < 64; shift += 7 )
+  {
+    const std::uint8_t b = readByte();
+    n |= static_cast< std::uint64_t >( b & 0x7f ) << shift;
+    if ( ( b & 0x80 ) == 0 )
+    {
+      return n;
+    }
+  }
+  throw std::runtime_error( "Malformed integer in binary data" );
+}
+
+std::int64_t BinaryReader::readInt()
+{
+  const std::uint64_t n = readVarint();
+  return static_cast< std::int64_t >( n >> 1 ) ^ -static_cast< std::int64_t >( n & 1 );
+}
+
+double BinaryReader::readDouble()
+{
+  if ( bytes.size() - position < sizeof( double ) )
+  {
+    throw std::runtime_error( "Unexpected end of binary data" );
+  }
+
+  double d = 0.0;
+  std::memcpy( &d, bytes.data() + position, sizeof( double ) );
+  position += sizeof( double );
+  return d;
+}
+
+std::string_view BinaryReader::readString()
+{
+  const std::uint64_t size = readVarint();
+  if ( bytes.size() - position < size )
+  {
+    throw std::runtime_error( "Unexpected end of binary data" );
+  }
+
+  std::string_view s = bytes.substr( position, static_cast< std::size_t >( size ) );
+  position += static_cast< std::size_t >( size );
+  return s;
+}
+
+std::string_view BinaryReader::remaining() const
+{
+  return bytes.substr( position );
+}
+
+bool BinaryReader::isEnd() const
+{
+  return position >= bytes.size();
+}
+
+void serializeCells( BinaryWriter& writer, const Cells& cells )
+{
+  writer.writeVarint( cells.size() );
+  for ( auto it = cells.cbegin(); it != cells.cend(); ++it )
+  {
+    serialize( writer, **it );
+  }
+}
+
+void serialize( BinaryWriter& writer, const SValue& v )
+{
+  if ( auto sexpr = v.getIf< Cells >() )
+  {
+    writer.writeByte( static_cast< std::uint8_t >( ValueTag::SExpression ) );
+    serializeCells( writer, *sexpr );
+  }
+  else if ( auto qexpr = v.getIf< QExpr >() )
+  {
+    writer.writeByte( static_cast< std::uint8_t >( ValueTag::QExpression ) );
+    writer.writeVarint( qexpr->size() );
+    for ( const SValue& child : *qexpr )
+    {
+      serialize( writer, child );
+    }
+  }
+  else if ( auto symbol = v.getIf< Symbol >() )
+  {
+    writer.writeByte( static_cast< std::uint8_t >( ValueTag::Symbol ) );
+    writer.writeString( symbol->label() );
+  }
+  else if ( auto i = v.getIf< int >() )
+  {
+    writer.writeByte( static_cast< std::uint8_t >( ValueTag::Integer ) );
+    writer.writeInt( *i );
+  }
+  else if ( auto d = v.getIf< double >() )
+  {
+    writer.writeByte( static_cast< std::uint8_t >( ValueTag::Float ) );
+    writer.writeDouble( *d );
+  }
+  else if ( auto b = v.getIf< Boolean >() )
+  {
+    writer.writeByte( static_cast< std::uint8_t >( *b == Boolean::True ? ValueTag::True : ValueTag::False ) );
+  }
+  else if ( auto s = v.getIf< std::string >() )
+  {
+    writer.writeByte( static_cast< std::uint8_t >( ValueTag::String ) );
+    writer.writeString( *s );
+  }
+  else if ( auto e = v.getIf< Error >() )
+  {
+    writer.writeByte( static_cast< std::uint8_t >( ValueTag::Error ) );
+    writer.writeString( e->message );
+  }
+  else if ( auto l = v.getIf< Lambda >() )
+  {
+    writer.writeByte( static_cast< std::uint8_t >( ValueTag::Lambda ) );
+    serialize( writer, *l->formals );
+    serialize( writer, *l->body );
+
+    writer.writeVarint( l->captures.size() );
+    for ( std::size_t i = 0; i < l->captures.size(); ++i )
+    {
+      writer.writeString( l->captures[ i ].label() );
+      serialize( writer, l->captured[ i ] );
+    }
+
+    writer.writeVarint( l->arguments.size() );
+    for ( const SValue& argument : l->arguments )
+    {
+      serialize( writer, argument );
+    }
+
+    // The optimized body is kept, so a restored lambda runs the same code as the one that was stored.
+    writer.writeByte( l->optimized ? 1 : 0 );
+    if ( l->optimized )
+    {
+      serialize( writer, l->optimized->body );
+      writer.writeVarint( l->optimized->assumptions.size() );
+      for ( const Assumption& assumption : l->optimized->assumptions )
+      {
+        writer.writeString( assumption.symbol.label() );
+        serialize( writer, assumption.value );
+      }
+    }
+  }
+  else if ( auto vector = v.getIf< Vector >() )
+  {
+    // Only the elements of the view are stored. Views that share a trie are read back as separate tries.
+    writer.writeByte( static_cast< std::uint8_t >( ValueTag::Vector ) );
+    writer.writeVarint( vector->size() );
+    for ( const SValue& element : *vector )
+    {
+      serialize( writer, element );
+    }
+  }
+  else if ( auto map = v.getIf< HashMap >() )
+  {
+    writer.writeByte( static_cast< std::uint8_t >( ValueTag::HashMap ) );
+    writer.writeVarint( map->size() );
+    map->forEach( [ &writer ]( const SValue& key, const SValue& value ) {
+      serialize( writer, key );
+      serialize( writer, value );
+    } );
+  }
+  else if ( auto ints = v.getIf< IntArray >() )
+  {
+    writer.writeByte( static_cast< std::uint8_t >( ValueTag::IntArray ) );
+    writer.writeVarint( ints->size() );
+    for ( std::size_t i = 0; i < ints->size(); ++i )
+    {
+      writer.writeInt( ( *ints )[ i ] );
+    }
+  }
+  else if ( auto floats = v.getIf< FloatArray >() )
+  {
+    writer.writeByte( static_cast< std::uint8_t >( ValueTag::FloatArray ) );
+    writer.writeVarint( floats->size() );
+    for ( std::size_t i = 0; i < floats->size(); ++i )
+    {
+      writer.writeDouble( ( *floats )[ i ] );
+    }
+  }
+  else if ( auto table = v.getIf< Table >() )
+  {
+    writer.writeByte( static_cast< std::uint8_t >( ValueTag::Table ) );
+    writer.writeVarint( table->columns.size() );
+    for ( std::size_t i = 0; i < table->columns.size(); ++i )
+    {
+      writer.writeString( table->names[ i ] );
+      serialize( writer, table->columns[ i ] );
+    }
+  }
+  else if ( auto sequence = v.getIf< Sequence >() )
+  {
+    // A step is followed by its source.
+    writer.writeByte( static_cast< std::uint8_t >( ValueTag::Sequence ) );
+    writer.writeByte( static_cast< std::uint8_t >( sequence->step ) );
+    writer.writeInt( sequence->first );
+    writer.writeInt( sequence->last );
+    serialize( writer, sequence->function );
+    serialize( writer, sequence->start );
+    writer.writeByte( sequence->source ? 1 : 0 );
+    if ( sequence->source )
+    {
+      serialize( writer, SValue( *sequence->source ) );
+    }
+  }
+  else if ( auto f = v.getIf< CoreFunction >() )
+  {
+    // Built-ins are stored by name and linked again when read.
+    const CoreFunctionEntry* entry = findCoreFunction( *f );
+    if ( !entry )
+    {
+      throw std::runtime_error( "Function cannot be serialized" );
+    }
+    writer.writeByte( static_cast< std::uint8_t >( ValueTag::CoreFunction ) );
+    writer.writeString( entry->name.label() );
+  }
+  else
+  {
+    throw std::runtime_error( "Value type cannot be serialized" );
+  }
+}
+
+void serialize( BinaryWriter& writer, const Environment& e )
+{
+  writer.writeVarint( e.bindings().size() );
+  for ( const auto& [ symbol, value ] : e.bindings() )
+  {
+    writer.writeString( symbol.label() );
+    serialize( writer, *value );
+  }
+}
+
+Cells deserializeCells( BinaryReader& reader )
+{
+  const std::uint64_t size = reader.readVarint();
+  Cells cells;
+  for ( std::uint64_t i = 0; i < size; ++i )
+  {
+    cells.append( deserialize( reader ) );
+  }
+  return cells;
+}
+
+/// Read the size of a packed array. Each element takes at least a byte, so a larger size is malformed.
+std::size_t readArraySize( BinaryReader& reader )
+{
+  const std::uint64_t size = reader.readVarint();
+  if ( size > reader.remaining().size() )
+  {
+    throw std::runtime_error( "Unexpected end of binary data" );
+  }
+  return static_cast< std::size_t >( size );
+}
+
+std::unique_ptr< SValue > deserialize( BinaryReader& reader )
+{
+  switch ( static_cast< ValueTag >( reader.readByte() ) )
+  {
+  case ValueTag::SExpression:
+    return makeSValue( deserializeCells( reader ) );
+  case ValueTag::QExpression:
+    return makeSValue( QExpr( deserializeCells( reader ) ) );
+  case ValueTag::Symbol:
+    return makeSValue( Symbol( reader.readString() ) );
+  case ValueTag::Integer:
+    return makeSValue( static_cast< int >( reader.readInt() ) );
+  case ValueTag::Float:
+    return makeSValue( reader.readDouble() );
+  case ValueTag::False:
+    return makeSValue( Boolean::False );
+  case ValueTag::True:
+    return makeSValue( Boolean::True );
+  case ValueTag::String:
+    return makeSValue( std::string( reader.readString() ) );
+  case ValueTag::Error:
+    return makeSValue( Error{ std::string( reader.readString() ) } );
+  case ValueTag::Lambda:
+  {
+    std::unique_ptr< SValue > formals = deserialize( reader );
+    std::unique_ptr< SValue > body = deserialize( reader );
+    Lambda l( std::move( formals ), std::move( body ) );
+
+    const std::uint64_t captureCount = reader.readVarint();
+    for ( std::uint64_t i = 0; i < captureCount; ++i )
+    {
+      l.captures.push_back( Symbol( reader.readString() ) );
+      l.captured.push_back( std::move( *deserialize( reader ) ) );
+    }
+
+    const std::uint64_t argumentCount = reader.readVarint();
+    for ( std::uint64_t i = 0; i < argumentCount; ++i )
+    {
+      l.arguments.push_back( std::move( *deserialize( reader ) ) );
+    }
+
+    if ( reader.readByte() )
+    {
+      OptimizedBody optimized{ std::move( *deserialize( reader ) ), {}, nullptr };
+      const std::uint64_t assumptionCount = reader.readVarint();
+      for ( std::uint64_t i = 0; i < assumptionCount; ++i )
+      {
+        const Symbol symbol( reader.readString() );
+        optimized.assumptions.push_back( Assumption{ symbol, std::move( *deserialize( reader ) ) } );
+      }
+      l.optimized = std::make_shared< const OptimizedBody >( std::move( optimized ) );
+    }
+    return makeSValue( std::move( l ) );
+  }
+  case ValueTag::CoreFunction:
+  {
+    const CoreFunctionEntry* entry = findCoreFunction( Symbol( reader.readString() ) );
+    if ( !entry )
+    {
+      throw std::runtime_error( "Unknown function in binary data" );
+    }
+    return makeSValue( CoreFunction( entry->function ) );
+  }
+  case ValueTag::Vector:
+  {
+    const std::uint64_t size = reader.readVarint();
+    std::vector< SValue > elements;
+    for ( std::uint64_t i = 0; i < size; ++i )
+    {
+      elements.push_back( std::move( *deserialize( reader ) ) );
+    }
+    return makeSValue( Vector( std::move( elements ) ) );
+  }
+  case ValueTag::HashMap:
+  {
+    const std::uint64_t size = reader.readVarint();
+    HashMap map;
+    for ( std::uint64_t i = 0; i < size; ++i )
+    {
+      std::unique_ptr< SValue > key = deserialize( reader );
+      map = map.set( *key, *deserialize( reader ) );
+    }
+    return makeSValue( std::move( map ) );
+  }
+  case ValueTag::IntArray:
+  {
+    std::vector< int > elements( readArraySize( reader ) );
+    for ( int& element : elements )
+    {
+      element = static_cast< int >( reader.readInt() );
+    }
+    return makeSValue( IntArray( std::move( elements ) ) );
+  }
+  case ValueTag::FloatArray:
+  {
+    std::vector< double > elements( readArraySize( reader ) );
+    for ( double& element : elements )
+    {
+      element = reader.readDouble();
+    }
+    return makeSValue( FloatArray( std::move( elements ) ) );
+  }
+  case ValueTag::Table:
+  {
+    const std::uint64_t size = reader.readVarint();
+    Table table;
+    for ( std::uint64_t i = 0; i < size; ++i )
+    {
+      table.names.emplace_back( reader.readString() );
+      table.columns.push_back( std::move( *deserialize( reader ) ) );
+    }
+    return makeSValue( std::move( table ) );
+  }
+  case ValueTag::Sequence:
+  {
+    Sequence sequence;
+    const std::uint8_t step = reader.readByte();
+    if ( step > static_cast< std::uint8_t >( Sequence::Step::Drop ) )
+    {
+      throw std::runtime_error( "Unknown sequence step in binary data" );
+    }
+    sequence.step = static_cast< Sequence::Step >( step );
+    sequence.first = static_cast< int >( reader.readInt() );
+    sequence.last = static_cast< int >( reader.readInt() );
+    sequence.function = std::move( *deserialize( reader ) );
+    sequence.start = std::move( *deserialize( reader ) );
+    if ( reader.readByte() != 0 )
+    {
+      std::unique_ptr< SValue > source = deserialize( reader );
+      if ( !source->isType< Sequence >() )
+      {
+        throw std::runtime_error( "Sequence source must be a sequence in binary data" );
+      }
+      sequence.source = std::make_shared< const Sequence >( source->get< Sequence >() );
+    }
+    return makeSValue( std::move( sequence ) );
+  }
+  }
+  throw std::runtime_error( "Unknown value type in binary data" );
+}
+
+void deserialize( BinaryReader& reader, Environment& e )
+{
+  const std::uint64_t size = reader.readVarint();
+  for ( std::uint64_t i = 0; i < size; ++i )
+  {
+    const Symbol symbol( reader.readString() );
+    e.set( symbol, *deserialize( reader ) );
+  }
+}
+
+bool writeFileAtomically( const std::string& path, std::string_view header, std::string_view payload )
+{
+  const std::string temporaryPath = path + '.' + std::to_string( std::random_device()() ) + ".tmp";
+  {
+    std::ofstream writer( temporaryPath, std::ios::binary );
+    writer.write( header.data(), header.size() );
+    writer.write( payload.data(), payload.size() );
+    if ( !writer )
+    {
+      writer.close();
+      std::error_code ignored;
+      std::filesystem::remove( temporaryPath, ignored );
+      return false;
+    }
+  }
+
+  std::error_code error;
+  std::filesystem::rename( temporaryPath, path, error );
+  if ( error )
+  {
+    std::filesystem::remove( temporaryPath, error );
+    return false;
+  }
+  return true;
+}
+
+std::uint64_t hashBytes( std::string_view bytes )
+{
+  constexpr std::uint64_t prime = 0x100000001b3ull;
+  constexpr std::uint64_t mixer = 0x9e3779b97f4a7c15ull;
+
+  std::uint64_t hash = 0xcbf29ce484222325ull ^ bytes.size();
+
+  // Mix a word at a time, then the remaining bytes.
+  std::size_t i = 0;
+  for ( ; i + sizeof( std::uint64_t ) <= bytes.size(); i += sizeof( std::uint64_t ) )
+  {
+    std::uint64_t word = 0;
+    std::memcpy( &word, bytes.data() + i, sizeof( word ) );
+    word *= mixer;
+    word ^= word >> 32;
+    hash = ( hash ^ word ) * prime;
+  }
+
+  for ( ; i < bytes.size(); ++i )
+  {
+    hash = ( hash ^ static_cast< unsigned char >( bytes[ i ] ) ) * prime;
+  }
+
+  return hash ^ ( hash >> 29 );
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+
+class Environment;
+class SValue;
+
+/// @brief Appends binary data to a buffer.
+/// Integers are variable length encoded, so small values take a single byte.
+class BinaryWriter
+{
+public:
+  void writeByte( std::uint8_t b );
+  void writeVarint( std::uint64_t n );
+  void writeInt( std::int64_t n );
+  void writeDouble( double d );
+  void writeString( std::string_view s );
+
+  const std::string& bytes() const;
+
+private:
+  std::string buffer;
+};
+
+/// @brief Reads binary data written by BinaryWriter.
+/// Throws if the data ends early or is malformed.
+class BinaryReader
+{
+public:
+  explicit BinaryReader( std::string_view bytes );
+
+  std::uint8_t readByte();
+  std::uint64_t readVarint();
+  std::int64_t readInt();
+  double readDouble();
+  std::string_view readString();
+
+  /// The bytes that have not been read yet.
+  std::string_view remaining() const;
+
+  bool isEnd() const;
+
+private:
+  std::string_view bytes;
+  std::size_t position = 0;
+};
+
+/// @brief Write an SValue tree.
+/// Built-in functions are written by name. Throws for functions that are not built-ins.
+void serialize( BinaryWriter& writer, const SValue& v );
+
+/// @brief Read an SValue tree written by serialize. Built-in functions are linked by name.
+std::unique_ptr< SValue > deserialize( BinaryReader& reader );
+
+/// @brief Write the bindings of the environment. Parents are not included.
+void serialize( BinaryWriter& writer, const Environment& e );
+
+/// @brief Read bindings written by serialize into the environment.
+void deserialize( BinaryReader& reader, Environment& e );
+
+/// @brief Write the file through a unique temporary file that is renamed.
+/// Concurrent readers never see a partially written file.
+/// @return False if the file could not be written.
+bool writeFileAtomically( const std::string& path, std::string_view header, std::string_view payload );
+
+/// @brief 64-bit FNV style hash of the bytes, mixed a word at a time. Not cryptographic.
+std::uint64_t hashBytes( std::string_view bytes );
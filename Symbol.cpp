@@ -1,17 +1,50 @@
 
 #include "Symbol.h"
 
-bool Symbol::operator==( const Symbol& other ) const
+#include <deque>
+#include <unordered_map>
+
+struct SymbolTable
+{
+  // Deque so the labels do not move when new symbols are interned.
+  std::deque< std::string > labels;
+  std::unordered_map< std::string_view, std::uint32_t > ids;
+};
+
+SymbolTable& symbolTable()
 {
-  return label == other.label;
+  // Leaked so symbols stay valid during static destruction.
+  static SymbolTable* table = new SymbolTable();
+  return *table;
 }
 
-std::size_t SymbolHash::operator()( const Symbol& s ) const
+Symbol::Symbol( std::string_view label )
 {
-  return std::hash< std::string >()( s.label );
+  SymbolTable& table = symbolTable();
+
+  auto it = table.ids.find( label );
+  if ( it != table.ids.end() )
+  {
+    id = it->second;
+    return;
+  }
+
+  id = static_cast< std::uint32_t >( table.labels.size() );
+  table.labels.emplace_back( label );
+  table.ids.emplace( table.labels.back(), id );
 }
 
+const std::string& Symbol::label() const
+{
+  return symbolTable().labels[ id ];
+}
+
+const Symbol conditionalSymbol( "if" );
+const Symbol defSymbol( "def" );
+const Symbol assignSymbol( "=" );
+const Symbol variadicSymbol( "&" );
+
 std::ostream& operator<<( std::ostream& o, const Symbol& s )
 {
-  return o << s.label;
+  return o << s.label();
 }
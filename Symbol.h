@@ -1,18 +1,41 @@
 #pragma once
 
+#include <cstdint>
 #include <ostream>
 #include <string>
+#include <string_view>
 
+/// An interned symbol. Symbols with the same label share an id,
+/// so comparing and hashing symbols only uses the id.
 struct Symbol
 {
-  std::string label;
+  /// Interns the label.
+  explicit Symbol( std::string_view label );
 
-  bool operator==( const Symbol& other ) const;
+  const std::string& label() const;
+
+  bool operator==( const Symbol& other ) const
+  {
+    return id == other.id;
+  }
+
+  std::uint32_t id;
 };
 
 struct SymbolHash
 {
-  std::size_t operator()( const Symbol& k ) const;
+  std::size_t operator()( const Symbol& k ) const
+  {
+    return k.id;
+  }
 };
 
 std::ostream& operator<<( std::ostream& o, const Symbol& s );
+
+// Symbols that the evaluator, the compiler, and the optimizer treat specially.
+extern const Symbol conditionalSymbol;
+extern const Symbol defSymbol;
+extern const Symbol assignSymbol;
+
+// Marks the variadic formal of a lambda.
+extern const Symbol variadicSymbol;
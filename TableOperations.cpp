@@ -0,0 +1,705 @@
+#include "TableOperations.h"
+
+#include "CsvReader.h"
+#include "Evaluator.h"
+#include "Ordering.h"
+#include "SValue.h"
+
+#include <algorithm>
+#include <charconv>
+#include <fstream>
+#include <initializer_list>
+#include <numeric>
+#include <optional>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+bool isColumn( const SValue& s )
+{
+  return s.isType< IntArray >() || s.isType< FloatArray >() || s.isType< Vector >();
+}
+
+std::size_t columnSize( const SValue& column )
+{
+  if ( const IntArray* ints = column.getIf< IntArray >() )
+  {
+    return ints->size();
+  }
+  if ( const FloatArray* floats = column.getIf< FloatArray >() )
+  {
+    return floats->size();
+  }
+  return column.get< Vector >().size();
+}
+
+/// The column for an array, vector, or Q-expression. A Q-expression of all integers or all floats is packed.
+std::optional< SValue > makeColumn( const SValue& s )
+{
+  if ( isColumn( s ) )
+  {
+    return s;
+  }
+
+  const QExpr* list = s.getIf< QExpr >();
+  if ( !list )
+  {
+    return std::nullopt;
+  }
+
+  const auto isAll = [ list ]( auto isType ) { return std::all_of( list->begin(), list->end(), isType ); };
+  if ( !list->isEmpty() && isAll( []( const SValue& x ) { return x.isType< int >(); } ) )
+  {
+    std::vector< int > elements;
+    std::transform( list->begin(), list->end(), std::back_inserter( elements ), []( const SValue& x ) { return x.get< int >(); } );
+    return SValue( IntArray( std::move( elements ) ) );
+  }
+  if ( !list->isEmpty() && isAll( []( const SValue& x ) { return x.isType< double >(); } ) )
+  {
+    std::vector< double > elements;
+    std::transform( list->begin(), list->end(), std::back_inserter( elements ), []( const SValue& x ) { return x.get< double >(); } );
+    return SValue( FloatArray( std::move( elements ) ) );
+  }
+  return SValue( Vector( std::vector< SValue >( list->begin(), list->end() ) ) );
+}
+
+/// The value in the row of the column.
+SValue cellAt( const SValue& column, std::size_t row )
+{
+  if ( const IntArray* ints = column.getIf< IntArray >() )
+  {
+    return SValue( ( *ints )[ row ] );
+  }
+  if ( const FloatArray* floats = column.getIf< FloatArray >() )
+  {
+    return SValue( ( *floats )[ row ] );
+  }
+  return column.get< Vector >()[ row ];
+}
+
+template < typename NumericT >
+NumericArray< NumericT > gatherElements( const NumericArray< NumericT >& column, const std::vector< std::size_t >& rows )
+{
+  std::vector< NumericT > elements( rows.size() );
+  for ( std::size_t i = 0; i < rows.size(); ++i )
+  {
+    elements[ i ] = column[ rows[ i ] ];
+  }
+  return NumericArray< NumericT >( std::move( elements ) );
+}
+
+/// The column with only the rows, in their order.
+SValue gather( const SValue& column, const std::vector< std::size_t >& rows )
+{
+  if ( const IntArray* ints = column.getIf< IntArray >() )
+  {
+    return SValue( gatherElements( *ints, rows ) );
+  }
+  if ( const FloatArray* floats = column.getIf< FloatArray >() )
+  {
+    return SValue( gatherElements( *floats, rows ) );
+  }
+
+  const Vector& values = column.get< Vector >();
+  std::vector< SValue > elements;
+  elements.reserve( rows.size() );
+  for ( std::size_t row : rows )
+  {
+    elements.push_back( values[ row ] );
+  }
+  return SValue( Vector( std::move( elements ) ) );
+}
+
+Table gatherRows( const Table& t, const std::vector< std::size_t >& rows )
+{
+  Table result;
+  result.names = t.names;
+  for ( const SValue& column : t.columns )
+  {
+    result.columns.push_back( gather( column, rows ) );
+  }
+  return result;
+}
+
+SValue* table( SValue* v )
+{
+  Cells& args = v->cellsRequired();
+  REQUIRE( v, args.size() == 2, "table requires 2 arguments" );
+  REQUIRE( v, args[ 0 ]->isQExpression() && args[ 1 ]->isQExpression(), "table expects a QExpression of names and of columns" );
+  REQUIRE( v, args[ 0 ]->size() == args[ 1 ]->size(), "table expects a name for each column" );
+
+  Table result;
+  const QExpr& names = std::as_const( *args[ 0 ] ).get< QExpr >();
+  const QExpr& columns = std::as_const( *args[ 1 ] ).get< QExpr >();
+  auto column = columns.begin();
+  for ( const SValue& name : names )
+  {
+    REQUIRE( v, name.isType< std::string >(), "table column names must be strings" );
+    REQUIRE( v, !result.column( name.get< std::string >() ), "table column names must be unique" );
+
+    std::optional< SValue > values = makeColumn( *column++ );
+    REQUIRE( v, values, "table columns must be arrays, vectors, or QExpressions" );
+    REQUIRE( v, result.columns.empty() || columnSize( *values ) == result.rows(), "table columns must have the same length" );
+
+    result.names.push_back( name.get< std::string >() );
+    result.columns.push_back( std::move( *values ) );
+  }
+
+  v->value = std::move( result );
+  return v;
+}
+
+/// Check that the arguments are a table and then the count of other arguments.
+/// @return The error message, or null.
+const char* checkTableArguments( const Cells& args, std::size_t count, const char* message )
+{
+  return args.size() == count && args[ 0 ]->isType< Table >() ? nullptr : message;
+}
+
+SValue* tableColumn( SValue* v )
+{
+  Cells& args = v->cellsRequired();
+  const char* message = checkTableArguments( args, 2, "tcol expects a table and a column name" );
+  REQUIRE( v, !message && args[ 1 ]->isType< std::string >(), "tcol expects a table and a column name" );
+
+  const SValue* column = std::as_const( *args[ 0 ] ).get< Table >().column( args[ 1 ]->get< std::string >() );
+  REQUIRE( v, column, "tcol column not found" );
+
+  *v = *column;
+  return v;
+}
+
+SValue* tableNames( SValue* v )
+{
+  Cells& args = v->cellsRequired();
+  const char* message = checkTableArguments( args, 1, "tnames expects a table" );
+  REQUIRE( v, !message, message );
+
+  Cells names;
+  for ( const std::string& name : std::as_const( *args[ 0 ] ).get< Table >().names )
+  {
+    names.append( makeSValue( name ) );
+  }
+
+  v->value = QExpr( std::move( names ) );
+  return v;
+}
+
+SValue* tableRows( SValue* v )
+{
+  Cells& args = v->cellsRequired();
+  const char* message = checkTableArguments( args, 1, "trows expects a table" );
+  REQUIRE( v, !message, message );
+
+  v->value = static_cast< int >( std::as_const( *args[ 0 ] ).get< Table >().rows() );
+  return v;
+}
+
+SValue* tableSelect( SValue* v )
+{
+  Cells& args = v->cellsRequired();
+  const char* message = checkTableArguments( args, 2, "tselect expects a table and a QExpression of names" );
+  REQUIRE( v, !message && args[ 1 ]->isQExpression(), "tselect expects a table and a QExpression of names" );
+
+  const Table& t = std::as_const( *args[ 0 ] ).get< Table >();
+  Table result;
+  for ( const SValue& name : std::as_const( *args[ 1 ] ).get< QExpr >() )
+  {
+    REQUIRE( v, name.isType< std::string >(), "tselect column names must be strings" );
+
+    const SValue* column = t.column( name.get< std::string >() );
+    REQUIRE( v, column, "tselect column not found" );
+
+    result.names.push_back( name.get< std::string >() );
+    result.columns.push_back( *column );
+  }
+
+  v->value = std::move( result );
+  return v;
+}
+
+/// The rows where the mask is not 0.
+std::vector< std::size_t > maskedRows( const IntArray& mask )
+{
+  std::vector< std::size_t > rows;
+  for ( std::size_t i = 0; i < mask.size(); ++i )
+  {
+    if ( mask[ i ] != 0 )
+    {
+      rows.push_back( i );
+    }
+  }
+  return rows;
+}
+
+SValue* tableFilter( SValue* v )
+{
+  Cells& args = v->cellsRequired();
+  const char* message = checkTableArguments( args, 2, "tfilter expects a table and a mask" );
+  REQUIRE( v, !message && args[ 1 ]->isType< IntArray >(), "tfilter expects a table and a mask" );
+
+  const Table& t = std::as_const( *args[ 0 ] ).get< Table >();
+  const IntArray& mask = std::as_const( *args[ 1 ] ).get< IntArray >();
+  REQUIRE( v, mask.size() == t.rows(), "tfilter mask must have a value for each row" );
+
+  v->value = gatherRows( t, maskedRows( mask ) );
+  return v;
+}
+
+/// True for the built-in comparisons, which give a mask when called with whole columns.
+bool isColumnComparison( const SValue& f )
+{
+  const CoreFunction* callable = f.getIf< CoreFunction >();
+  const CoreFunctionPtr* target = callable ? callable->target< CoreFunctionPtr >() : nullptr;
+  return target && ( *target == evalLesser || *target == evalLesserEqual || *target == evalGreater ||
+                     *target == evalGreaterEqual );
+}
+
+/// The cells of a form, or of a Q-expression body.
+std::vector< const SValue* > formCells( const SValue& form )
+{
+  std::vector< const SValue* > cells;
+  form.foreachCell( [ &cells ]( const SValue& cell ) { cells.push_back( &cell ); } );
+  return cells;
+}
+
+/// Checks the body of a lambda predicate, before it is called, for whether it also works on whole columns.
+/// The body may only apply built-ins that work element by element on arrays to the formals and numbers.
+class ColumnBodyCheck
+{
+public:
+  ColumnBodyCheck( const Environment& e, const Lambda& l ) : l( l ), globals( &e )
+  {
+    while ( globals->parent() )
+    {
+      globals = globals->parent();
+    }
+  }
+
+  /// A form that gives a boolean for values and a mask for columns.
+  bool isMask( const SValue& form ) const
+  {
+    const std::vector< const SValue* > cells = formCells( form );
+    if ( calls( cells, { "<", "<=", ">", ">=" } ) )
+    {
+      return cells.size() == 3 && isNumber( *cells[ 1 ] ) && isNumber( *cells[ 2 ] );
+    }
+
+    const bool isLogical =
+      calls( cells, { "and", "or" } ) ? cells.size() > 1 : calls( cells, { "not" } ) && cells.size() == 2;
+    return isLogical && std::all_of( cells.begin() + 1, cells.end(), [ this ]( const SValue* argument ) {
+             return argument->isSExpression() && isMask( *argument );
+           } );
+  }
+
+private:
+  /// A number, a formal, or arithmetic on them. A number for values and an array for columns.
+  bool isNumber( const SValue& s ) const
+  {
+    if ( s.isType< int >() || s.isType< double >() )
+    {
+      return true;
+    }
+    if ( const Symbol* symbol = s.getIf< Symbol >() )
+    {
+      return isFormal( *symbol );
+    }
+    if ( !s.isSExpression() )
+    {
+      return false;
+    }
+
+    const std::vector< const SValue* > cells = formCells( s );
+    return calls( cells, { "+", "-", "*", "/", "mod" } ) && cells.size() > 1 &&
+           std::all_of( cells.begin() + 1, cells.end(), [ this ]( const SValue* argument ) {
+             return isNumber( *argument );
+           } );
+  }
+
+  /// The form calls one of the named built-ins. The name must not be bound in the lambda, that would hide the built-in.
+  bool calls( const std::vector< const SValue* >& cells, std::initializer_list< const char* > names ) const
+  {
+    const Symbol* operation = cells.empty() ? nullptr : cells.front()->getIf< Symbol >();
+    if ( !operation || isFormal( *operation ) ||
+         std::find( l.captures.begin(), l.captures.end(), *operation ) != l.captures.end() )
+    {
+      return false;
+    }
+
+    const SValue* bound = globals->findLocal( *operation );
+    const CoreFunction* f = bound ? bound->getIf< CoreFunction >() : nullptr;
+    const CoreFunctionEntry* builtin = f ? findCoreFunction( *f ) : nullptr;
+    return builtin && std::any_of( names.begin(), names.end(), [ builtin ]( const char* name ) {
+             return builtin->name == Symbol( name );
+           } );
+  }
+
+  bool isFormal( const Symbol& symbol ) const
+  {
+    const QExpr& formals = std::as_const( *l.formals ).get< QExpr >();
+    return std::any_of( formals.begin(), formals.end(), [ &symbol ]( const SValue& formal ) {
+      return formal.isType< Symbol >() && formal.get< Symbol >() == symbol;
+    } );
+  }
+
+  const Lambda& l;
+  const Environment* globals;
+};
+
+/// True for a lambda that can be called once with the whole columns instead of once for each row.
+/// It takes one numeric column for each formal and its body passes ColumnBodyCheck.
+bool isColumnLambda( const Environment& e, const SValue& f, const std::vector< const SValue* >& columns )
+{
+  const Lambda* l = f.getIf< Lambda >();
+  if ( !l || !l->arguments.empty() )
+  {
+    return false;
+  }
+
+  const QExpr& formals = std::as_const( *l->formals ).get< QExpr >();
+  const bool areNumericColumns = std::all_of( columns.begin(), columns.end(), []( const SValue* column ) {
+    return column->isType< IntArray >() || column->isType< FloatArray >();
+  } );
+  const bool isVariadic = std::any_of( formals.begin(), formals.end(), []( const SValue& formal ) {
+    return formal.isType< Symbol >() && formal.get< Symbol >() == variadicSymbol;
+  } );
+  return formals.size() == columns.size() && areNumericColumns && !isVariadic &&
+         ColumnBodyCheck( e, *l ).isMask( *l->body );
+}
+
+SValue* tableWhere( Environment& e, SValue* v )
+{
+  Cells& args = v->cellsRequired();
+  const char* message = checkTableArguments( args, 3, "twhere expects a table, column names, and a predicate" );
+  REQUIRE( v, !message && args[ 1 ]->isQExpression() && !args[ 1 ]->isEmpty(), "twhere expects a table, column names, and a predicate" );
+
+  const Table& t = std::as_const( *args[ 0 ] ).get< Table >();
+  std::vector< const SValue* > columns;
+  for ( const SValue& name : std::as_const( *args[ 1 ] ).get< QExpr >() )
+  {
+    const SValue* column = name.isType< std::string >() ? t.column( name.get< std::string >() ) : nullptr;
+    REQUIRE( v, column, "twhere column not found" );
+    columns.push_back( column );
+  }
+
+  // A built-in comparison, or a lambda that only compares and combines the columns, is called once with the whole
+  // columns and gives a mask. Which way the predicate is called is decided here, before it runs.
+  if ( isColumnComparison( *args[ 2 ] ) || isColumnLambda( e, *args[ 2 ], columns ) )
+  {
+    Cells call;
+    call.append( makeSValue( *args[ 2 ] ) );
+    for ( const SValue* column : columns )
+    {
+      call.append( makeSValue( *column ) );
+    }
+
+    SValue mask = evaluateSexpr( e, std::move( call ) );
+    if ( mask.isError() )
+    {
+      *v = std::move( mask );
+      return v;
+    }
+
+    const bool isMask = mask.isType< IntArray >() && mask.get< IntArray >().size() == t.rows();
+    REQUIRE( v, isMask, "twhere expects a mask with a value for each row" );
+    v->value = gatherRows( t, maskedRows( mask.get< IntArray >() ) );
+    return v;
+  }
+
+  // Other predicates are called once for each row with the values of the row.
+  std::vector< std::size_t > rows;
+  for ( std::size_t row = 0; row < t.rows(); ++row )
+  {
+    Cells rowCall;
+    rowCall.append( makeSValue( *args[ 2 ] ) );
+    for ( const SValue* column : columns )
+    {
+      rowCall.append( makeSValue( cellAt( *column, row ) ) );
+    }
+
+    SValue keep = evaluateSexpr( e, std::move( rowCall ) );
+    if ( keep.isError() )
+    {
+      *v = std::move( keep );
+      return v;
+    }
+
+    REQUIRE( v, keep.isType< Boolean >(), "twhere expects a boolean from the predicate" );
+    if ( keep.get< Boolean >() == Boolean::True )
+    {
+      rows.push_back( row );
+    }
+  }
+
+  v->value = gatherRows( t, rows );
+  return v;
+}
+
+/// Aggregate the values of each group with the operation. Null if the operation is unknown.
+template < typename NumericT >
+std::optional< SValue > aggregate(
+  const NumericArray< NumericT >& values, const std::vector< std::size_t >& groupOf, std::size_t groups, const std::string& operation )
+{
+  if ( operation == "mean" )
+  {
+    std::vector< double > sums( groups );
+    std::vector< std::size_t > counts( groups );
+    for ( std::size_t row = 0; row < values.size(); ++row )
+    {
+      sums[ groupOf[ row ] ] += values[ row ];
+      ++counts[ groupOf[ row ] ];
+    }
+    for ( std::size_t g = 0; g < groups; ++g )
+    {
+      sums[ g ] /= static_cast< double >( counts[ g ] );
+    }
+    return SValue( FloatArray( std::move( sums ) ) );
+  }
+
+  NumericT ( *combine )( NumericT, NumericT ) = nullptr;
+  if ( operation == "sum" )
+  {
+    combine = []( NumericT x, NumericT y ) { return x + y; };
+  }
+  else if ( operation == "min" )
+  {
+    combine = []( NumericT x, NumericT y ) { return std::min( x, y ); };
+  }
+  else if ( operation == "max" )
+  {
+    combine = []( NumericT x, NumericT y ) { return std::max( x, y ); };
+  }
+  else
+  {
+    return std::nullopt;
+  }
+
+  // Every group has a row, the first one starts its result.
+  std::vector< NumericT > results( groups );
+  std::vector< bool > isStarted( groups );
+  for ( std::size_t row = 0; row < values.size(); ++row )
+  {
+    const std::size_t g = groupOf[ row ];
+    results[ g ] = isStarted[ g ] ? combine( results[ g ], values[ row ] ) : values[ row ];
+    isStarted[ g ] = true;
+  }
+  return SValue( NumericArray< NumericT >( std::move( results ) ) );
+}
+
+SValue* tableGroup( SValue* v )
+{
+  Cells& args = v->cellsRequired();
+  const char* message = checkTableArguments( args, 4, "tgroup expects a table, key and value column names, and an aggregation" );
+  const bool areStrings = std::all_of( args.cbegin() + 1, args.cend(), []( const auto& s ) { return s->template isType< std::string >(); } );
+  REQUIRE( v, !message && areStrings, "tgroup expects a table, key and value column names, and an aggregation" );
+
+  const Table& t = std::as_const( *args[ 0 ] ).get< Table >();
+  const std::string& keyName = args[ 1 ]->get< std::string >();
+  const std::string& valueName = args[ 2 ]->get< std::string >();
+  const std::string& operation = args[ 3 ]->get< std::string >();
+
+  const SValue* keys = t.column( keyName );
+  const SValue* values = t.column( valueName );
+  REQUIRE( v, keys && values, "tgroup column not found" );
+  REQUIRE( v, !keys->isType< FloatArray >(), "tgroup keys must be integers, strings, or symbols" );
+
+  // Number the groups in the order their keys first appear.
+  std::unordered_map< SValue, std::size_t, KeyHash > groupIds;
+  std::vector< std::size_t > groupOf( t.rows() );
+  std::vector< std::size_t > firstRows;
+  for ( std::size_t row = 0; row < t.rows(); ++row )
+  {
+    SValue key = cellAt( *keys, row );
+    REQUIRE( v, HashMap::isKey( key ), "tgroup keys must be integers, strings, or symbols" );
+
+    auto [ it, isNew ] = groupIds.emplace( std::move( key ), firstRows.size() );
+    if ( isNew )
+    {
+      firstRows.push_back( row );
+    }
+    groupOf[ row ] = it->second;
+  }
+
+  std::optional< SValue > aggregated;
+  if ( operation == "count" )
+  {
+    std::vector< int > counts( firstRows.size() );
+    for ( std::size_t g : groupOf )
+    {
+      ++counts[ g ];
+    }
+    aggregated = SValue( IntArray( std::move( counts ) ) );
+  }
+  else if ( const IntArray* ints = values->getIf< IntArray >() )
+  {
+    aggregated = aggregate( *ints, groupOf, firstRows.size(), operation );
+  }
+  else if ( const FloatArray* floats = values->getIf< FloatArray >() )
+  {
+    aggregated = aggregate( *floats, groupOf, firstRows.size(), operation );
+  }
+  else
+  {
+    return error( v, "tgroup can only count values that are not numbers" );
+  }
+  REQUIRE( v, aggregated, "tgroup aggregation must be count, sum, min, max, or mean" );
+
+  Table result;
+  result.names = { keyName, valueName };
+  result.columns.push_back( gather( *keys, firstRows ) );
+  result.columns.push_back( std::move( *aggregated ) );
+  v->value = std::move( result );
+  return v;
+}
+
+template < typename NumericT >
+void sortRows( std::vector< std::size_t >& rows, const NumericArray< NumericT >& column )
+{
+  std::stable_sort( rows.begin(), rows.end(), [ &column ]( std::size_t a, std::size_t b ) { return column[ a ] < column[ b ]; } );
+}
+
+SValue* tableSort( SValue* v )
+{
+  Cells& args = v->cellsRequired();
+  const char* message = checkTableArguments( args, 2, "tsort expects a table and a column name" );
+  REQUIRE( v, !message && args[ 1 ]->isType< std::string >(), "tsort expects a table and a column name" );
+
+  const Table& t = std::as_const( *args[ 0 ] ).get< Table >();
+  const SValue* column = t.column( args[ 1 ]->get< std::string >() );
+  REQUIRE( v, column, "tsort column not found" );
+
+  std::vector< std::size_t > rows( t.rows() );
+  std::iota( rows.begin(), rows.end(), 0 );
+  if ( const IntArray* ints = column->getIf< IntArray >() )
+  {
+    sortRows( rows, *ints );
+  }
+  else if ( const FloatArray* floats = column->getIf< FloatArray >() )
+  {
+    sortRows( rows, *floats );
+  }
+  else
+  {
+    const Vector& values = column->get< Vector >();
+    const bool areStrings = std::all_of( values.begin(), values.end(), []( const SValue& s ) { return s.isType< std::string >(); } );
+    REQUIRE( v, areStrings, "tsort expects a column of numbers or strings" );
+
+    std::stable_sort( rows.begin(), rows.end(), [ &values ]( std::size_t a, std::size_t b ) {
+      return values[ a ].get< std::string >() < values[ b ].get< std::string >();
+    } );
+  }
+
+  v->value = gatherRows( t, rows );
+  return v;
+}
+
+/// Parse the whole field as a number.
+template < typename NumericT >
+bool parseField( const std::string& field, NumericT& x )
+{
+  const char* end = field.data() + field.size();
+  const auto [ parsed, status ] = std::from_chars( field.data(), end, x );
+  return !field.empty() && status == std::errc() && parsed == end;
+}
+
+/// Try to read all fields as numbers.
+template < typename NumericT >
+std::optional< SValue > parseColumn( const std::vector< std::string >& fields )
+{
+  std::vector< NumericT > elements( fields.size() );
+  for ( std::size_t i = 0; i < fields.size(); ++i )
+  {
+    if ( !parseField( fields[ i ], elements[ i ] ) )
+    {
+      return std::nullopt;
+    }
+  }
+  return SValue( NumericArray< NumericT >( std::move( elements ) ) );
+}
+
+/// The column for the fields. Integers or floats when they all are, otherwise strings.
+SValue typedColumn( std::vector< std::string >& fields )
+{
+  if ( std::optional< SValue > ints = parseColumn< int >( fields ) )
+  {
+    return std::move( *ints );
+  }
+  if ( std::optional< SValue > floats = parseColumn< double >( fields ) )
+  {
+    return std::move( *floats );
+  }
+
+  std::vector< SValue > strings;
+  strings.reserve( fields.size() );
+  for ( std::string& field : fields )
+  {
+    strings.push_back( SValue( std::move( field ) ) );
+  }
+  return SValue( Vector( std::move( strings ) ) );
+}
+
+SValue* tableCsv( SValue* v )
+{
+  Cells& args = v->cellsRequired();
+  REQUIRE( v, args.size() == 1 && args.front()->isType< std::string >(), "tcsv expects a path" );
+
+  std::ifstream reader( args.front()->get< std::string >(), std::ios::binary );
+  if ( !reader.good() )
+  {
+    return error( v, "Could not read file" );
+  }
+
+  // The fields of each column. The first record is the header.
+  std::vector< std::string > names;
+  std::vector< std::vector< std::string > > fields;
+  std::size_t records = 0;
+  CsvReader csv( [ &names, &fields, &records ]( std::vector< std::string >& record ) {
+    ++records;
+    if ( records == 1 )
+    {
+      names = std::move( record );
+      fields.resize( names.size() );
+      return;
+    }
+
+    if ( record.size() != names.size() )
+    {
+      throw std::runtime_error(
+        "CSV record " + std::to_string( records ) + " has " + std::to_string( record.size() ) + " fields, expected " +
+        std::to_string( names.size() ) );
+    }
+    for ( std::size_t i = 0; i < record.size(); ++i )
+    {
+      fields[ i ].push_back( std::move( record[ i ] ) );
+    }
+  } );
+
+  try
+  {
+    constexpr std::size_t chunkSize = 64 * 1024;
+    std::vector< char > chunk( chunkSize );
+    while ( reader.read( chunk.data(), chunk.size() ) || reader.gcount() > 0 )
+    {
+      csv.feed( std::string_view( chunk.data(), static_cast< std::size_t >( reader.gcount() ) ) );
+    }
+    csv.finish();
+  }
+  catch ( const std::runtime_error& e )
+  {
+    return error( v, e.what() );
+  }
+
+  REQUIRE( v, records > 0, "tcsv expects a header line" );
+
+  Table result;
+  for ( std::size_t i = 0; i < names.size(); ++i )
+  {
+    REQUIRE( v, !result.column( names[ i ] ), "tcsv column names must be unique" );
+    result.names.push_back( std::move( names[ i ] ) );
+    result.columns.push_back( typedColumn( fields[ i ] ) );
+  }
+
+  v->value = std::move( result );
+  return v;
+}
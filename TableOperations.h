@@ -0,0 +1,43 @@
+#pragma once
+
+class Environment;
+class SValue;
+
+/// @brief Makes a table from column names and columns. ( table {"x" "name"} (list xs names) )
+/// A column is an array, a vector, or a Q-expression, which becomes an array when all are integers or all are floats.
+SValue* table( SValue* v );
+
+/// @brief Gets the column with the name. ( tcol t "x" )
+SValue* tableColumn( SValue* v );
+
+/// @brief Gets the column names as a Q-expression. ( tnames t )
+SValue* tableNames( SValue* v );
+
+/// @brief Gets the number of rows. ( trows t )
+SValue* tableRows( SValue* v );
+
+/// @brief Returns a table with only the named columns, in that order. ( tselect t {"x" "y"} )
+SValue* tableSelect( SValue* v );
+
+/// @brief Returns the rows where the integer mask is not 0. e.g. ( tfilter t (> (tcol t "x") 3) )
+SValue* tableFilter( SValue* v );
+
+/// @brief Returns the rows for which the predicate is true. ( twhere t {"x" "y"} (\ {x y} {< x y}) )
+/// The predicate is called for each row with the values of the row. A built-in comparison, e.g. <, is instead
+/// called once with the whole columns. So is a lambda on numeric columns whose body only compares the formals and
+/// numbers, arithmetic on them, and combines the comparisons with and, or, and not.
+/// e.g. ( twhere t {"x" "y"} (\ {x y} {and (> x 0) (< (+ x y) 10)}) )
+/// Use tfilter to select rows with a mask computed from the columns.
+SValue* tableWhere( Environment& e, SValue* v );
+
+/// @brief Groups the rows by the key column and aggregates the value column in each group.
+/// The aggregation is "count", "sum", "min", "max", or "mean". Groups are in the order their keys first appear.
+/// ( tgroup t "key" "value" "sum" )
+SValue* tableGroup( SValue* v );
+
+/// @brief Returns the rows sorted by the column, ascending. Equal rows keep their order. ( tsort t "x" )
+SValue* tableSort( SValue* v );
+
+/// @brief Reads a table from a CSV file with a header line. ( tcsv "data.csv" )
+/// Columns of integers or floats become arrays, other columns are vectors of strings.
+SValue* tableCsv( SValue* v );
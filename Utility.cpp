@@ -2,12 +2,30 @@
 #include "Utility.h"
 
 #include "Evaluator.h"
+#include "MappedFile.h"
+#include "Optimizer.h"
 #include "Parser.h"
 #include "SValue.h"
+#include "ScriptCache.h"
 
 #include <fstream>
 #include <iostream>
 #include <sstream>
+#include <vector>
+
+bool showAllocationStatistics = false;
+
+void setShowAllocationStatistics( bool show )
+{
+  showAllocationStatistics = show;
+}
+
+bool cacheScripts = false;
+
+void setCacheScripts( bool cache )
+{
+  cacheScripts = cache;
+}
 
 // v contains the string path
 SValue* evalLoad( Environment& e, SValue* v )
@@ -19,30 +37,83 @@ SValue* evalLoad( Environment& e, SValue* v )
   std::unique_ptr< SValue > file = cells.takeFront();
   REQUIRE( v, file->isType< std::string >(), "load requires a string argument" );
 
-  std::ifstream reader( file->get< std::string >() );
-  if ( !reader.good() )
-  {
-    return error( v, "Could not read file" );
-  }
-
-  std::string text( ( std::istreambuf_iterator< char >( reader ) ), std::istreambuf_iterator< char >() );
-  std::unique_ptr< SValue > script = parse( text.cbegin(), text.cend() );
-  Cells& scriptExpressions = script->cellsRequired();
-  while ( !scriptExpressions.isEmpty() )
-  {
-    std::unique_ptr< SValue > v = scriptExpressions.takeFront();
+  return loadScript( e, v, file->get< std::string >(), cacheScripts );
+}
 
+SValue* loadScript( Environment& e, SValue* v, const std::string& path, bool useCache )
+{
+  auto evaluateForm = [ &e ]( std::unique_ptr< SValue > v ) {
     std::ostringstream ss;
     show( ss, *v );
     std::string exprString = ss.str();
 
+    const AllocationCounters before = allocationCounters();
+
+    optimizeForm( e, *v );
     SValue* result = evaluate( e, v.get() );
     if ( result->isError() )
     {
       std::cout << exprString << '\n';
       std::cout << *result << '\n';
     }
+
+    if ( showAllocationStatistics )
+    {
+      const AllocationCounters& after = allocationCounters();
+      std::cerr << "allocations: " << ( after.allocations - before.allocations )
+                << " bytes: " << ( after.bytesAllocated - before.bytesAllocated ) << " in " << exprString << '\n';
+    }
+  };
+
+  // Lex directly over the mapped file. Tokens are only copied into the values they create.
+  MappedFile mapped( path );
+  if ( mapped.isOpen() && useCache )
+  {
+    // Use the precompiled forms if the cache matches the source. Otherwise parse and update the cache.
+    ScriptCache cache( path, mapped.contents() );
+    if ( cache.load( evaluateForm ) )
+    {
+      return empty( v );
+    }
+
+    // Evaluate each top-level form as soon as it is parsed.
+    Parser parser( [ &cache, &evaluateForm ]( std::unique_ptr< SValue > form ) {
+      cache.add( *form );
+      evaluateForm( std::move( form ) );
+    } );
+    parser.feed( mapped.contents() );
+    parser.finish();
+    if ( !cache.save() )
+    {
+      std::cerr << "Could not write the script cache for " << path << '\n';
+    }
+    return empty( v );
+  }
+
+  if ( mapped.isOpen() )
+  {
+    Parser parser( evaluateForm );
+    parser.feed( mapped.contents() );
+    parser.finish();
+    return empty( v );
   }
+
+  // Fall back to reading in chunks. e.g. Pipes and devices cannot be mapped.
+  std::ifstream reader( path );
+  if ( !reader.good() )
+  {
+    return error( v, "Could not read file" );
+  }
+
+  Parser parser( evaluateForm );
+  constexpr std::size_t chunkSize = 64 * 1024;
+  std::vector< char > chunk( chunkSize );
+  while ( reader.read( chunk.data(), chunk.size() ) || reader.gcount() > 0 )
+  {
+    parser.feed( std::string_view( chunk.data(), static_cast< std::size_t >( reader.gcount() ) ) );
+  }
+  parser.finish();
+
   return empty( v );
 }
 
@@ -1,9 +1,21 @@
 #pragma once
 
+#include <string>
+
 class SValue;
 class Environment;
 
 SValue* evalLoad( Environment& e, SValue* v );
+
+/// Evaluate each top-level form of the script. v is the result, e.g. an error if the script cannot be read.
+/// With useCache, the parsed forms are read from and written to the script cache. See ScriptCache.
+SValue* loadScript( Environment& e, SValue* v, const std::string& path, bool useCache );
 SValue* evalPrint( Environment& e, SValue* v );
 SValue* evalError( Environment& e, SValue* v );
 SValue* evalShow( Environment& e, SValue* v );
+
+/// Print the node allocations of each top-level form evaluated by load to stderr.
+void setShowAllocationStatistics( bool show );
+
+/// Use the script cache for the scripts given to load. The standard library always uses it.
+void setCacheScripts( bool cache );
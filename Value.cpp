@@ -0,0 +1,219 @@
+#include "Value.h"
+#include "SValue.h"
+
+#include <new>
+
+// Out of line objects are allocated from the node allocator.
+template < typename T, typename... Args >
+ValueObjectHeader* createObject( Args&&... args )
+{
+  return new ( allocateNode( sizeof( ValueObject< T > ) ) ) ValueObject< T >( std::forward< Args >( args )... );
+}
+
+template < typename T >
+void destroyObject( ValueObjectHeader* object )
+{
+  static_cast< ValueObject< T >* >( object )->~ValueObject< T >();
+  deallocateNode( object, sizeof( ValueObject< T > ) );
+}
+
+Value::Value() : object( createObject< Cells >() ), tag( Type::SExpression )
+{}
+
+Value::Value( Cells c ) : object( createObject< Cells >( std::move( c ) ) ), tag( Type::SExpression )
+{}
+
+Value::Value( QExpr q ) : object( createObject< QExpr >( std::move( q ) ) ), tag( Type::QExpression )
+{}
+
+Value::Value( CoreFunction f ) : object( createObject< CoreFunction >( std::move( f ) ) ), tag( Type::CoreFunction )
+{}
+
+Value::Value( Lambda l ) : object( createObject< Lambda >( std::move( l ) ) ), tag( Type::Lambda )
+{}
+
+Value::Value( std::string s ) : object( createObject< std::string >( std::move( s ) ) ), tag( Type::String )
+{}
+
+Value::Value( Error e ) : object( createObject< Error >( std::move( e ) ) ), tag( Type::Error )
+{}
+
+Value::Value( Vector v ) : object( createObject< Vector >( std::move( v ) ) ), tag( Type::Vector )
+{}
+
+Value::Value( HashMap m ) : object( createObject< HashMap >( std::move( m ) ) ), tag( Type::HashMap )
+{}
+
+Value::Value( NumericArray< int > a ) : object( createObject< NumericArray< int > >( std::move( a ) ) ), tag( Type::IntArray )
+{}
+
+Value::Value( NumericArray< double > a )
+  : object( createObject< NumericArray< double > >( std::move( a ) ) ), tag( Type::FloatArray )
+{}
+
+Value::Value( Table t ) : object( createObject< Table >( std::move( t ) ) ), tag( Type::Table )
+{}
+
+Value::Value( Sequence s ) : object( createObject< Sequence >( std::move( s ) ) ), tag( Type::Sequence )
+{}
+
+Value::Value( const Value& other ) : tag( other.tag )
+{
+  if ( other.isOutOfLine() )
+  {
+    // Share the object.
+    object = other.object;
+    ++object->references;
+  }
+  else
+  {
+    copyPayload( other );
+  }
+}
+
+Value& Value::operator=( const Value& other )
+{
+  if ( this != &other )
+  {
+    // Copy first, other may be owned by this value.
+    Value copy( other );
+    *this = std::move( copy );
+  }
+  return *this;
+}
+
+Value::Value( Value&& other ) noexcept : tag( other.tag )
+{
+  // Takes the object, if any. The moved from value becomes the integer 0.
+  copyPayload( other );
+  other.integer = 0;
+  other.tag = Type::Integer;
+}
+
+Value& Value::operator=( Value&& other ) noexcept
+{
+  if ( this != &other )
+  {
+    // Take the object before destroying ours, other may be owned by this value.
+    Value taken( std::move( other ) );
+
+    if ( isOutOfLine() )
+    {
+      release();
+    }
+
+    copyPayload( taken );
+    tag = taken.tag;
+    taken.integer = 0;
+    taken.tag = Type::Integer;
+  }
+  return *this;
+}
+
+void Value::copyPayload( const Value& other )
+{
+  switch ( other.tag )
+  {
+  case Type::Integer:
+    integer = other.integer;
+    break;
+  case Type::Float:
+    number = other.number;
+    break;
+  case Type::Boolean:
+    boolean = other.boolean;
+    break;
+  case Type::Symbol:
+    symbol = other.symbol;
+    break;
+  default:
+    object = other.object;
+    break;
+  }
+}
+
+void Value::unshare()
+{
+  ValueObjectHeader* copy = nullptr;
+  visit( [ &copy ]( const auto& item ) {
+    using T = std::decay_t< decltype( item ) >;
+    copy = createObject< T >( item );
+  } );
+
+  --object->references;
+  object = copy;
+}
+
+void Value::release()
+{
+  if ( --object->references != 0 )
+  {
+    return;
+  }
+
+  switch ( tag )
+  {
+  case Type::SExpression:
+    destroyObject< Cells >( object );
+    break;
+  case Type::QExpression:
+    destroyObject< QExpr >( object );
+    break;
+  case Type::CoreFunction:
+    destroyObject< CoreFunction >( object );
+    break;
+  case Type::Lambda:
+    destroyObject< Lambda >( object );
+    break;
+  case Type::String:
+    destroyObject< std::string >( object );
+    break;
+  case Type::Error:
+    destroyObject< Error >( object );
+    break;
+  case Type::Vector:
+    destroyObject< Vector >( object );
+    break;
+  case Type::HashMap:
+    destroyObject< HashMap >( object );
+    break;
+  case Type::IntArray:
+    destroyObject< NumericArray< int > >( object );
+    break;
+  case Type::FloatArray:
+    destroyObject< NumericArray< double > >( object );
+    break;
+  case Type::Table:
+    destroyObject< Table >( object );
+    break;
+  case Type::Sequence:
+    destroyObject< Sequence >( object );
+    break;
+  default:
+    break;
+  }
+}
+
+bool Value::operator==( const Value& other ) const
+{
+  if ( tag != other.tag )
+  {
+    return false;
+  }
+
+  if ( isOutOfLine() && object == other.object )
+  {
+    return true;
+  }
+
+  return visit( [ &other ]( const auto& item ) {
+    using T = std::decay_t< decltype( item ) >;
+    return item == other.unchecked< T >();
+  } );
+}
+
+std::ostream& operator<<( std::ostream& o, const Value& value )
+{
+  value.visit( [ &o ]( const auto& item ) { o << item; } );
+  return o;
+}
@@ -0,0 +1,299 @@
+#pragma once
+
+#include "Symbol.h"
+
+#include <cstdint>
+#include <functional>
+#include <iosfwd>
+#include <string>
+#include <type_traits>
+#include <variant>
+
+class Cells;
+class Environment;
+class SValue;
+struct Error;
+struct HashMap;
+struct Table;
+struct Sequence;
+
+template < typename NumericT >
+struct NumericArray;
+struct Lambda;
+struct QExpr;
+struct Vector;
+
+/// Wrapper for bool type so it works with Value.
+/// Using bool in Value can cause issues due to implicit conversions.
+enum class Boolean
+{
+  False,
+  True
+};
+
+/// A built-in function.
+/// The environment can be modified by the function.
+/// The S-expression can be modified and reduced (evaluated) by the function.
+/// It returns the new, evalauted S-expression.
+using CoreFunction = std::function< SValue*( Environment&, SValue* v ) >;
+
+/// Reference count of an out of line value object.
+struct ValueObjectHeader
+{
+  std::size_t references = 1;
+};
+
+template < typename T >
+struct ValueObject : ValueObjectHeader
+{
+  template < typename... Args >
+  explicit ValueObject( Args&&... args ) : value( std::forward< Args >( args )... )
+  {}
+
+  T value;
+};
+
+/// @brief Compact tagged value. A Value is 16 bytes.
+/// Integers, floats, booleans, and symbols are stored inline.
+/// Other types are stored out of line in a reference counted object.
+/// Copies share the object. Mutable access to a shared object copies it first (copy on write),
+/// so a deep copy only happens when a shared value is modified.
+/// Access follows std::variant. get throws std::bad_variant_access for the wrong type.
+class Value
+{
+public:
+  enum class Type : std::uint8_t
+  {
+    SExpression,
+    QExpression,
+    CoreFunction,
+    Symbol,
+    Lambda,
+    Integer,
+    Float,
+    Boolean,
+    String,
+    Error,
+    Vector,
+    HashMap,
+    IntArray,
+    FloatArray,
+    Table,
+    Sequence
+  };
+
+  /// An empty S-expression.
+  Value();
+
+  Value( int i ) : integer( i ), tag( Type::Integer )
+  {}
+
+  Value( double d ) : number( d ), tag( Type::Float )
+  {}
+
+  Value( Boolean b ) : boolean( b ), tag( Type::Boolean )
+  {}
+
+  Value( Symbol s ) : symbol( s ), tag( Type::Symbol )
+  {}
+
+  Value( Cells c );
+  Value( QExpr q );
+  Value( CoreFunction f );
+  Value( Lambda l );
+  Value( std::string s );
+  Value( Error e );
+  Value( Vector v );
+  Value( HashMap m );
+  Value( NumericArray< int > a );
+  Value( NumericArray< double > a );
+  Value( Table t );
+  Value( Sequence s );
+
+  Value( const Value& other );
+  Value& operator=( const Value& other );
+
+  Value( Value&& other ) noexcept;
+  Value& operator=( Value&& other ) noexcept;
+
+  ~Value()
+  {
+    if ( isOutOfLine() )
+    {
+      release();
+    }
+  }
+
+  Type type() const
+  {
+    return tag;
+  }
+
+  template < typename T >
+  bool is() const
+  {
+    return tag == typeOf< T >();
+  }
+
+  template < typename T >
+  T* getIf()
+  {
+    return is< T >() ? &unchecked< T >() : nullptr;
+  }
+
+  template < typename T >
+  const T* getIf() const
+  {
+    return is< T >() ? &unchecked< T >() : nullptr;
+  }
+
+  template < typename T >
+  T& get()
+  {
+    if ( !is< T >() )
+    {
+      throw std::bad_variant_access();
+    }
+    return unchecked< T >();
+  }
+
+  template < typename T >
+  const T& get() const
+  {
+    if ( !is< T >() )
+    {
+      throw std::bad_variant_access();
+    }
+    return unchecked< T >();
+  }
+
+  /// True if the out of line object is shared with another value.
+  bool isShared() const
+  {
+    return isOutOfLine() && object->references > 1;
+  }
+
+  /// Call f with the held value.
+  template < typename F >
+  decltype( auto ) visit( F&& f ) const
+  {
+    switch ( tag )
+    {
+    case Type::SExpression:
+      return f( unchecked< Cells >() );
+    case Type::QExpression:
+      return f( unchecked< QExpr >() );
+    case Type::CoreFunction:
+      return f( unchecked< CoreFunction >() );
+    case Type::Symbol:
+      return f( unchecked< Symbol >() );
+    case Type::Lambda:
+      return f( unchecked< Lambda >() );
+    case Type::Integer:
+      return f( integer );
+    case Type::Float:
+      return f( number );
+    case Type::Boolean:
+      return f( boolean );
+    case Type::String:
+      return f( unchecked< std::string >() );
+    case Type::Vector:
+      return f( unchecked< Vector >() );
+    case Type::HashMap:
+      return f( unchecked< HashMap >() );
+    case Type::IntArray:
+      return f( unchecked< NumericArray< int > >() );
+    case Type::FloatArray:
+      return f( unchecked< NumericArray< double > >() );
+    case Type::Table:
+      return f( unchecked< Table >() );
+    case Type::Sequence:
+      return f( unchecked< Sequence >() );
+    case Type::Error:
+    default:
+      return f( unchecked< Error >() );
+    }
+  }
+
+  bool operator==( const Value& other ) const;
+
+private:
+  template < typename T >
+  static constexpr Type typeOf()
+  {
+    if constexpr ( std::is_same_v< T, Cells > ) return Type::SExpression;
+    else if constexpr ( std::is_same_v< T, QExpr > ) return Type::QExpression;
+    else if constexpr ( std::is_same_v< T, CoreFunction > ) return Type::CoreFunction;
+    else if constexpr ( std::is_same_v< T, Symbol > ) return Type::Symbol;
+    else if constexpr ( std::is_same_v< T, Lambda > ) return Type::Lambda;
+    else if constexpr ( std::is_same_v< T, int > ) return Type::Integer;
+    else if constexpr ( std::is_same_v< T, double > ) return Type::Float;
+    else if constexpr ( std::is_same_v< T, Boolean > ) return Type::Boolean;
+    else if constexpr ( std::is_same_v< T, std::string > ) return Type::String;
+    else if constexpr ( std::is_same_v< T, Vector > ) return Type::Vector;
+    else if constexpr ( std::is_same_v< T, HashMap > ) return Type::HashMap;
+    else if constexpr ( std::is_same_v< T, NumericArray< int > > ) return Type::IntArray;
+    else if constexpr ( std::is_same_v< T, NumericArray< double > > ) return Type::FloatArray;
+    else if constexpr ( std::is_same_v< T, Table > ) return Type::Table;
+    else if constexpr ( std::is_same_v< T, Sequence > ) return Type::Sequence;
+    else
+    {
+      static_assert( std::is_same_v< T, Error >, "Value does not hold this type" );
+      return Type::Error;
+    }
+  }
+
+  template < typename T >
+  T& unchecked()
+  {
+    if constexpr ( std::is_same_v< T, int > ) return integer;
+    else if constexpr ( std::is_same_v< T, double > ) return number;
+    else if constexpr ( std::is_same_v< T, Boolean > ) return boolean;
+    else if constexpr ( std::is_same_v< T, Symbol > ) return symbol;
+    else
+    {
+      if ( object->references > 1 )
+      {
+        unshare();
+      }
+      return static_cast< ValueObject< T >* >( object )->value;
+    }
+  }
+
+  template < typename T >
+  const T& unchecked() const
+  {
+    if constexpr ( std::is_same_v< T, int > ) return integer;
+    else if constexpr ( std::is_same_v< T, double > ) return number;
+    else if constexpr ( std::is_same_v< T, Boolean > ) return boolean;
+    else if constexpr ( std::is_same_v< T, Symbol > ) return symbol;
+    else return static_cast< const ValueObject< T >* >( object )->value;
+  }
+
+  bool isOutOfLine() const
+  {
+    return tag != Type::Integer && tag != Type::Float && tag != Type::Boolean && tag != Type::Symbol;
+  }
+
+  /// Copy the active member of other. The object, if any, is not referenced again.
+  void copyPayload( const Value& other );
+
+  /// Replace the shared out of line object with a copy owned only by this value.
+  void unshare();
+
+  /// Release the out of line object. It is destroyed when no other value shares it.
+  void release();
+
+  union
+  {
+    int integer;
+    double number;
+    Boolean boolean;
+    Symbol symbol;
+    ValueObjectHeader* object;
+  };
+
+  Type tag;
+};
+
+std::ostream& operator<<( std::ostream& o, const Value& value );
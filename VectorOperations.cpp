@@ -0,0 +1,94 @@
+#include "VectorOperations.h"
+
+#include "SValue.h"
+
+#include <utility>
+#include <vector>
+
+/// True if the value is an index of the vector.
+bool isIndex( const Vector& vector, const SValue& index )
+{
+  return index.isType< int >() && index.get< int >() >= 0 && static_cast< std::size_t >( index.get< int >() ) < vector.size();
+}
+
+SValue* vector( SValue* v )
+{
+  Cells& args = v->cellsRequired();
+  REQUIRE( v, args.size() == 1, "vector requires 1 argument" );
+  REQUIRE( v, args.front()->isQExpression(), "vector expects a QExpression" );
+
+  const QExpr& list = std::as_const( *args.front() ).get< QExpr >();
+  v->value = Vector( std::vector< SValue >( list.begin(), list.end() ) );
+  return v;
+}
+
+SValue* vectorList( SValue* v )
+{
+  Cells& args = v->cellsRequired();
+  REQUIRE( v, args.size() == 1, "vlist requires 1 argument" );
+  REQUIRE( v, args.front()->isType< Vector >(), "vlist expects a vector" );
+
+  v->value = std::as_const( *args.front() ).get< Vector >().toList();
+  return v;
+}
+
+SValue* vectorLength( SValue* v )
+{
+  Cells& args = v->cellsRequired();
+  REQUIRE( v, args.size() == 1, "vlen requires 1 argument" );
+  REQUIRE( v, args.front()->isType< Vector >(), "vlen expects a vector" );
+
+  v->value = static_cast< int >( std::as_const( *args.front() ).get< Vector >().size() );
+  return v;
+}
+
+SValue* vectorGet( SValue* v )
+{
+  Cells& args = v->cellsRequired();
+  REQUIRE( v, args.size() == 2, "vget requires 2 arguments" );
+  REQUIRE( v, args[ 0 ]->isType< Vector >(), "vget expects a vector" );
+
+  const Vector& vector = std::as_const( *args[ 0 ] ).get< Vector >();
+  REQUIRE( v, isIndex( vector, *args[ 1 ] ), "vget index out of range" );
+
+  *v = vector[ args[ 1 ]->get< int >() ];
+  return v;
+}
+
+SValue* vectorSet( SValue* v )
+{
+  Cells& args = v->cellsRequired();
+  REQUIRE( v, args.size() == 3, "vset requires 3 arguments" );
+  REQUIRE( v, args[ 0 ]->isType< Vector >(), "vset expects a vector" );
+
+  REQUIRE( v, isIndex( std::as_const( *args[ 0 ] ).get< Vector >(), *args[ 1 ] ), "vset index out of range" );
+
+  v->value = std::as_const( *args[ 0 ] ).get< Vector >().set( args[ 1 ]->get< int >(), std::move( *args[ 2 ] ) );
+  return v;
+}
+
+SValue* vectorPush( SValue* v )
+{
+  Cells& args = v->cellsRequired();
+  REQUIRE( v, args.size() == 2, "vpush requires 2 arguments" );
+  REQUIRE( v, args[ 0 ]->isType< Vector >(), "vpush expects a vector" );
+
+  v->value = std::as_const( *args[ 0 ] ).get< Vector >().push( std::move( *args[ 1 ] ) );
+  return v;
+}
+
+SValue* vectorSlice( SValue* v )
+{
+  Cells& args = v->cellsRequired();
+  REQUIRE( v, args.size() == 3, "vslice requires 3 arguments" );
+  REQUIRE( v, args[ 0 ]->isType< Vector >(), "vslice expects a vector" );
+  REQUIRE( v, args[ 1 ]->isType< int >() && args[ 2 ]->isType< int >(), "vslice expects integer bounds" );
+
+  const Vector& vector = std::as_const( *args[ 0 ] ).get< Vector >();
+  const int begin = args[ 1 ]->get< int >();
+  const int end = args[ 2 ]->get< int >();
+  REQUIRE( v, 0 <= begin && begin <= end && static_cast< std::size_t >( end ) <= vector.size(), "vslice bounds out of range" );
+
+  v->value = vector.slice( begin, end );
+  return v;
+}
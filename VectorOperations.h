@@ -0,0 +1,25 @@
+#pragma once
+
+class SValue;
+
+/// @brief Converts a Q-expression to a vector. ( vector {1 2 3} )
+SValue* vector( SValue* v );
+
+/// @brief Converts a vector to a Q-expression. ( vlist v )
+SValue* vectorList( SValue* v );
+
+/// @brief Gets the length of the vector. ( vlen v )
+SValue* vectorLength( SValue* v );
+
+/// @brief Gets the element at the index, in a few steps even for millions of elements. ( vget v i )
+SValue* vectorGet( SValue* v );
+
+/// @brief Returns the vector with the element at the index set. ( vset v i x )
+/// Only the path to the element is copied. Other vectors that share the rest are not changed.
+SValue* vectorSet( SValue* v );
+
+/// @brief Returns the vector with an element added to the end. Only the path to it is copied. ( vpush v x )
+SValue* vectorPush( SValue* v );
+
+/// @brief Returns the elements from begin up to end, sharing the elements. ( vslice v begin end )
+SValue* vectorSlice( SValue* v );
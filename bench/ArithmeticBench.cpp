@@ -0,0 +1,81 @@
+// Time per call of the arithmetic and comparison built-ins, with two integer or two float arguments.
+// Usage: ArithmeticBench [calls]
+
+#include "Evaluator.h"
+#include "SValue.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+
+/// The best time of several runs, in nanoseconds per call.
+double bestNanoseconds( int calls, const std::function< void() >& run )
+{
+  double best = 1e9;
+  for ( int i = 0; i < 7; ++i )
+  {
+    const auto start = std::chrono::steady_clock::now();
+    run();
+    const std::chrono::duration< double, std::nano > nanoseconds = std::chrono::steady_clock::now() - start;
+    best = std::min( best, nanoseconds.count() / calls );
+  }
+  return best;
+}
+
+/// The arguments of a call, (i 2) or (i.0 2.0).
+SValue makeArguments( int i, bool isFloat )
+{
+  Cells cells;
+  if ( isFloat )
+  {
+    cells.append( makeSValue( static_cast< double >( i ) ) );
+    cells.append( makeSValue( 2.0 ) );
+  }
+  else
+  {
+    cells.append( makeSValue( i ) );
+    cells.append( makeSValue( 2 ) );
+  }
+  return SValue( std::move( cells ) );
+}
+
+int main( int argc, char** argv )
+{
+  const int calls = argc > 1 ? std::atoi( argv[ 1 ] ) : 2000000;
+
+  Environment e;
+  addCoreFunctions( e );
+
+  // Counted so that the calls are not optimized away.
+  long long checksum = 0;
+
+  std::printf( "%d calls, best of 7 runs, building the arguments excluded\n", calls );
+  for ( const bool isFloat : { false, true } )
+  {
+    const double building = bestNanoseconds( calls, [ & ] {
+      for ( int i = 0; i < calls; ++i )
+      {
+        SValue arguments = makeArguments( i, isFloat );
+        checksum += arguments.size();
+      }
+    } );
+
+    for ( const char* name : { "+", "-", "*", "/", "<", ">=", "eq" } )
+    {
+      const CoreFunctionPtr f = findCoreFunction( Symbol( name ) )->function;
+      const double call = bestNanoseconds( calls, [ & ] {
+        for ( int i = 0; i < calls; ++i )
+        {
+          SValue arguments = makeArguments( i, isFloat );
+          f( e, &arguments );
+          checksum += arguments.isError();
+        }
+      } );
+      std::printf( "(%s a b) %-5s: %6.1f ns\n", name, isFloat ? "float" : "int", call - building );
+    }
+    std::printf( "building the arguments %-5s: %.1f ns\n", isFloat ? "float" : "int", building );
+  }
+  return checksum < 0 ? 1 : 0;
+}
@@ -0,0 +1,84 @@
+// Large argument lists and large files, which consume cells from the front.
+// Usage: CellsBench [count]
+
+#include "Evaluator.h"
+#include "Parser.h"
+#include "SValue.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <string>
+
+/// The best time of several runs, in seconds.
+double bestSeconds( const std::function< void() >& run )
+{
+  double best = 1e9;
+  for ( int i = 0; i < 5; ++i )
+  {
+    const auto start = std::chrono::steady_clock::now();
+    run();
+    const std::chrono::duration< double > seconds = std::chrono::steady_clock::now() - start;
+    best = std::min( best, seconds.count() );
+  }
+  return best;
+}
+
+/// The numbers from 0 up to count, separated by spaces.
+std::string numbers( int count )
+{
+  std::string text;
+  for ( int i = 0; i < count; ++i )
+  {
+    text += std::to_string( i ) + ' ';
+  }
+  return text;
+}
+
+/// Parse the source and evaluate each top-level form as soon as it is parsed, like load.
+void load( Environment& e, const std::string& source )
+{
+  Parser parser( [ &e ]( std::unique_ptr< SValue > form ) { evaluate( e, form.get() ); } );
+  parser.feed( source );
+  parser.finish();
+}
+
+int main( int argc, char** argv )
+{
+  const int count = argc > 1 ? std::atoi( argv[ 1 ] ) : 100000;
+
+  Environment e;
+  addCoreFunctions( e );
+
+  const double takeFront = bestSeconds( [ count ] {
+    Cells cells;
+    for ( int i = 0; i < count; ++i )
+    {
+      cells.append( makeSValue( i ) );
+    }
+    while ( cells.size() > 0 )
+    {
+      cells.takeFront();
+    }
+  } );
+
+  const std::string add = "(+ " + numbers( count ) + ")";
+  const std::string length = "(len (list " + numbers( count ) + "))";
+  const std::string join = "(join {" + numbers( count ) + "} {" + numbers( count ) + "})";
+
+  std::string defs;
+  for ( int i = 0; i < count; ++i )
+  {
+    defs += "(def {v" + std::to_string( i ) + "} " + std::to_string( i ) + ")\n";
+  }
+
+  std::printf( "%d cells, best of 5 runs\n", count );
+  std::printf( "append, then takeFront until empty: %.4f s\n", takeFront );
+  std::printf( "(+ 0 1 ...):                        %.4f s\n", bestSeconds( [ & ] { load( e, add ); } ) );
+  std::printf( "(len (list 0 1 ...)):               %.4f s\n", bestSeconds( [ & ] { load( e, length ); } ) );
+  std::printf( "(join {0 1 ...} {0 1 ...}):         %.4f s\n", bestSeconds( [ & ] { load( e, join ); } ) );
+  std::printf( "file of %d top-level defs:      %.4f s\n", count, bestSeconds( [ & ] { load( e, defs ); } ) );
+  return 0;
+}
@@ -0,0 +1,143 @@
+// Lexer throughput in MB/s. The parser is compared with the regular expression tokenizer it replaced.
+// Usage: LexerBench [megabytes]
+
+#include "Parser.h"
+#include "SValue.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <regex>
+#include <string>
+#include <utility>
+#include <vector>
+
+/// A script of about the given size, with every kind of token.
+std::string makeScript( std::size_t bytes )
+{
+  std::string script;
+  for ( int i = 0; script.size() < bytes; ++i )
+  {
+    const std::string n = std::to_string( i );
+    script += "; Function " + n + " of the generated script\n";
+    script += "(fun {name_" + n + " x & xs} {\n";
+    script += "  if (>= x " + n + ") {+ x -" + n + " 1.25 (len xs)} {print \"a \\\"quoted\\\" string\" x}\n";
+    script += "})\n";
+  }
+  return script;
+}
+
+// The tokens of the original parser, tried in the same order.
+const std::regex symbolRegex( R"([a-zA-Z0-9_+\-*\/\\=<>!&]+)" );
+const std::regex integerRegex( "-?[0-9]+" );
+const std::regex floatRegex( "-?[0-9]+[.][0-9]+" );
+const std::regex stringLiteralRegex( R"("(\\.|[^"])*")" );
+const std::regex commentRegex( R"(;[^\r\n]*)" );
+
+const std::regex* const tokenRegexes[] = { &commentRegex, &floatRegex, &integerRegex, &stringLiteralRegex, &symbolRegex };
+
+/// Converts a token the way the original parser did, matching it again to classify it.
+Value readValue( const std::string& text )
+{
+  if ( text == "true" || text == "false" )
+  {
+    return Boolean( text == "true" ? Boolean::True : Boolean::False );
+  }
+  if ( std::regex_match( text, integerRegex ) )
+  {
+    return std::stoi( text );
+  }
+  if ( std::regex_match( text, floatRegex ) )
+  {
+    return std::stod( text );
+  }
+  if ( std::regex_match( text, stringLiteralRegex ) )
+  {
+    return std::string( text.cbegin() + 1, text.cend() - 1 );
+  }
+  return Symbol( text );
+}
+
+/// Tokenize like the original parser, without building the tree.
+/// @return The number of tokens.
+std::size_t regexTokenize( const std::string& script )
+{
+  std::size_t tokens = 0;
+  auto it = script.cbegin();
+  while ( it != script.cend() )
+  {
+    it = std::find_if_not( it, script.cend(), []( unsigned char c ) { return std::isspace( c ); } );
+    if ( it == script.cend() )
+    {
+      break;
+    }
+
+    if ( *it == '(' || *it == ')' || *it == '{' || *it == '}' )
+    {
+      ++tokens;
+      ++it;
+      continue;
+    }
+
+    bool isMatched = false;
+    for ( const std::regex* regex : tokenRegexes )
+    {
+      std::smatch match;
+      if ( std::regex_search( it, script.cend(), match, *regex, std::regex_constants::match_continuous ) )
+      {
+        if ( regex != &commentRegex )
+        {
+          readValue( match.str() );
+          ++tokens;
+        }
+        it += match.length();
+        isMatched = true;
+        break;
+      }
+    }
+
+    if ( !isMatched )
+    {
+      ++it;
+    }
+  }
+  return tokens;
+}
+
+/// Parse the whole script into forms.
+/// @return The number of top-level forms.
+std::size_t parseScript( const std::string& script )
+{
+  std::size_t forms = 0;
+  Parser parser( [ &forms ]( std::unique_ptr< SValue > ) { ++forms; } );
+  parser.feed( script );
+  parser.finish();
+  return forms;
+}
+
+/// The best throughput of several runs, in MB/s.
+double megabytesPerSecond( const std::string& script, const std::function< std::size_t( const std::string& ) >& run )
+{
+  double best = 0;
+  for ( int i = 0; i < 5; ++i )
+  {
+    const auto start = std::chrono::steady_clock::now();
+    run( script );
+    const std::chrono::duration< double > seconds = std::chrono::steady_clock::now() - start;
+    best = std::max( best, script.size() / 1e6 / seconds.count() );
+  }
+  return best;
+}
+
+int main( int argc, char** argv )
+{
+  const double megabytes = argc > 1 ? std::atof( argv[ 1 ] ) : 2.0;
+  const std::string script = makeScript( static_cast< std::size_t >( megabytes * 1e6 ) );
+
+  std::printf( "script: %.2f MB, %zu forms\n", script.size() / 1e6, parseScript( script ) );
+  std::printf( "regex tokenizer: %.1f MB/s (tokens only, no tree)\n", megabytesPerSecond( script, regexTokenize ) );
+  std::printf( "parser:          %.1f MB/s (tokens and tree)\n", megabytesPerSecond( script, parseScript ) );
+  return 0;
+}
@@ -0,0 +1,80 @@
+// Vector updates in loops, where the vector is also bound in the frame of each call.
+// Usage: VectorBench [count]
+
+#include "Evaluator.h"
+#include "Parser.h"
+#include "SValue.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <string>
+#include <vector>
+
+/// The best time of several runs, in seconds.
+double bestSeconds( const std::function< void() >& run )
+{
+  double best = 1e9;
+  for ( int i = 0; i < 5; ++i )
+  {
+    const auto start = std::chrono::steady_clock::now();
+    run();
+    const std::chrono::duration< double > seconds = std::chrono::steady_clock::now() - start;
+    best = std::min( best, seconds.count() );
+  }
+  return best;
+}
+
+/// Parse the source and evaluate each top-level form as soon as it is parsed, like load.
+void load( Environment& e, const std::string& source )
+{
+  Parser parser( [ &e ]( std::unique_ptr< SValue > form ) { evaluate( e, form.get() ); } );
+  parser.feed( source );
+  parser.finish();
+}
+
+int main( int argc, char** argv )
+{
+  const int count = argc > 1 ? std::atoi( argv[ 1 ] ) : 200000;
+  const std::string n = std::to_string( count );
+
+  Environment e;
+  addCoreFunctions( e );
+  load(
+    e,
+    "(def {fill} (\\ {t i n} {if (eq i n) {t} {fill (vset t i i) (+ i 1) n}}))\n"
+    "(def {grow} (\\ {t n} {if (eq n 0) {t} {grow (vpush t n) (- n 1)}}))\n"
+    "(def {total} (\\ {t i n acc} {if (eq i n) {acc} {total t (+ i 1) n (+ acc (vget t i))}}))\n"
+    "(def {zeros} (vector (range 1 " +
+      n + ")))\n" );
+
+  const double set = bestSeconds( [ & ] { load( e, "(fill zeros 0 " + n + ")" ); } );
+  const double push = bestSeconds( [ & ] { load( e, "(grow (vector {}) " + n + ")" ); } );
+  const double get = bestSeconds( [ & ] { load( e, "(total zeros 0 " + n + " 0)" ); } );
+
+  // The same updates without the interpreter.
+  const double setOnly = bestSeconds( [ count ] {
+    Vector v( std::vector< SValue >( count, SValue( 0 ) ) );
+    for ( int i = 0; i < count; ++i )
+    {
+      v = v.set( i, SValue( i ) );
+    }
+  } );
+  const double pushOnly = bestSeconds( [ count ] {
+    Vector v;
+    for ( int i = 0; i < count; ++i )
+    {
+      v = v.push( SValue( i ) );
+    }
+  } );
+
+  std::printf( "%d elements, best of 5 runs\n", count );
+  std::printf( "vset each element in a loop:  %.4f s (%.0f ns each)\n", set, set / count * 1e9 );
+  std::printf( "vpush each element in a loop: %.4f s (%.0f ns each)\n", push, push / count * 1e9 );
+  std::printf( "vget each element in a loop:  %.4f s (%.0f ns each)\n", get, get / count * 1e9 );
+  std::printf( "Vector::set only:             %.4f s (%.0f ns each)\n", setOnly, setOnly / count * 1e9 );
+  std::printf( "Vector::push only:            %.4f s (%.0f ns each)\n", pushOnly, pushOnly / count * 1e9 );
+  return 0;
+}
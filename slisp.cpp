@@ -1,12 +1,19 @@
 ﻿
 #include "slisp.h"
+#include "Bytecode.h"
+#include "EnvironmentImage.h"
 #include "Evaluator.h"
+#include "MappedFile.h"
+#include "Optimizer.h"
 #include "Parser.h"
 #include "SValue.h"
+#include "Serializer.h"
 #include "Utility.h"
 
+#include <algorithm>
 #include <filesystem>
 #include <iostream>
+#include <vector>
 
 void loadStandardLibrary( Environment& e, std::ostream& out )
 {
@@ -15,8 +22,7 @@ void loadStandardLibrary( Environment& e, std::ostream& out )
     if ( dir.is_regular_file() && dir.path().extension() == ".slisp" )
     {
       auto root = makeDefaultSValue();
-      root->cells()->append( makeSValue( dir.path().string() ) );
-      SValue* result = evalLoad( e, root.get() );
+      SValue* result = loadScript( e, root.get(), dir.path().string(), true );
       if ( result->isError() )
       {
         out << *result << '\n';
@@ -25,13 +31,57 @@ void loadStandardLibrary( Environment& e, std::ostream& out )
   }
 }
 
+// Image of the environment after the standard library is loaded.
+const std::string standardImagePath = "standard/standard.slispi";
+
+/// Key for the standard library image.
+/// Changes when the interpreter, its built-ins, or any standard library file changes.
+/// Lambdas in the image keep their optimized bodies, so it also changes with the optimizer setting.
+std::uint64_t standardLibraryKey()
+{
+  BinaryWriter key;
+  key.writeString( interpreterVersion );
+  key.writeByte( useOptimizer() ? 1 : 0 );
+  for ( const CoreFunctionEntry& c : coreFunctions() )
+  {
+    key.writeString( c.name.label() );
+  }
+
+  std::vector< std::string > paths;
+  for ( const auto& dir : std::filesystem::recursive_directory_iterator( "standard" ) )
+  {
+    if ( dir.is_regular_file() && dir.path().extension() == ".slisp" )
+    {
+      paths.push_back( dir.path().string() );
+    }
+  }
+  std::sort( paths.begin(), paths.end() );
+
+  for ( const std::string& path : paths )
+  {
+    key.writeString( path );
+    key.writeVarint( hashBytes( MappedFile( path ).contents() ) );
+  }
+
+  return hashBytes( key.bytes() );
+}
+
 Environment createDefaultEnvironment( std::ostream& out )
 {
   Environment env;
-  addCoreFunctions( env );
+  std::uint64_t imageKey = 0;
   try
   {
+    // Restore the image instead of evaluating the standard library again.
+    imageKey = standardLibraryKey();
+    if ( loadImage( env, standardImagePath, imageKey ) )
+    {
+      return env;
+    }
+
+    addCoreFunctions( env );
     loadStandardLibrary( env, out );
+    saveImage( env, standardImagePath, imageKey );
   }
   catch ( const std::exception& e )
   {
@@ -49,45 +99,63 @@ public:
 
     Environment env = createDefaultEnvironment( out );
 
+    // Forms of the current input. Input continues over several lines until all brackets are closed.
+    auto root = makeDefaultSValue();
+    Parser parser( [ &root ]( std::unique_ptr< SValue > form ) { root->cellsRequired().append( std::move( form ) ); } );
+
     bool isDone = false;
     while ( !isDone )
     {
-      out << ">> ";
+      out << ( parser.isComplete() ? ">> " : ".. " );
       std::string input;
-      std::getline( in, input );
+      if ( !std::getline( in, input ) )
+      {
+        break;
+      }
 
-      if ( input == "exit" )
+      if ( !parser.isComplete() )
+      {
+        // Continue the current input.
+      }
+      else if ( input == "exit" )
       {
         isDone = true;
         out << "Exiting\n";
+        continue;
       }
       else if ( input == "env" )
       {
         // Special command to show the environment.
         out << env << '\n';
+        continue;
       }
       else if ( input.empty() )
       {
         // Ignore blanks.
         continue;
       }
-      else
-      {
-        try
-        {
-          auto root = parse( input.cbegin(), input.cend() );
-          out << "ast:\n";
-          out << *root << '\n';
-          //show( out, *root ) << '\n';
 
-          auto result = evaluate( env, root.get() );
-          show( out, *result ) << '\n';
-        }
-        catch ( const std::exception& e )
+      try
+      {
+        parser.feed( input );
+        parser.feed( "\n" );
+        if ( !parser.isComplete() )
         {
-          out << e.what() << '\n';
+          continue;
         }
+
+        out << "ast:\n";
+        out << *root << '\n';
+        //show( out, *root ) << '\n';
+
+        auto result = evaluate( env, root.get() );
+        show( out, *result ) << '\n';
+      }
+      catch ( const std::exception& e )
+      {
+        out << e.what() << '\n';
       }
+      root = makeDefaultSValue();
     }
   }
 
@@ -95,13 +163,40 @@ public:
   std::istream& in = std::cin;
 };
 
+/// Remove the option from the arguments.
+/// @return True if the option was given.
+bool takeOption( std::vector< std::string >& args, const std::string& option )
+{
+  auto it = std::find( args.begin(), args.end(), option );
+  if ( it == args.end() )
+  {
+    return false;
+  }
+  args.erase( it );
+  return true;
+}
+
 int main( int argc, char** argv )
 {
-  if ( argc >= 2 )
+  std::vector< std::string > args( argv + 1, argv + argc );
+
+  // Options
+  // --alloc-stats  Print node allocations for each top-level form that is loaded.
+  // --cache-scripts  Cache the parsed forms of the script and the scripts it loads. See ScriptCache.
+  // --tree-walk    Evaluate lambda bodies with the tree-walking evaluator instead of bytecode.
+  // --no-optimize  Evaluate forms and lambda bodies as they are written.
+  // --show-optimized  Print each form the optimizer changes, before and after.
+  setShowAllocationStatistics( takeOption( args, "--alloc-stats" ) );
+  setCacheScripts( takeOption( args, "--cache-scripts" ) );
+  setUseBytecode( !takeOption( args, "--tree-walk" ) );
+  setOptimize( !takeOption( args, "--no-optimize" ) );
+  setShowOptimizedForms( takeOption( args, "--show-optimized" ) );
+
+  if ( !args.empty() )
   {
     Environment env = createDefaultEnvironment( std::cout );
 
-    const std::string filename( argv[ 1 ] );
+    const std::string filename( args.front() );
     auto root = makeDefaultSValue();
     root->cells()->append( makeSValue( filename ) );
 
@@ -117,7 +212,7 @@ int main( int argc, char** argv )
   }
   else
   {
-    std::cout << "*hxor's LISP v0.1\n";
+    std::cout << "*hxor's LISP v" << interpreterVersion << '\n';
     InteractiveEvaluator runner;
     runner.runInteractiveMode();
   }
@@ -1,3 +1,7 @@
 ﻿
 #pragma once
 
+#include <string_view>
+
+/// Version of the interpreter. Caches from other versions are not used.
+constexpr std::string_view interpreterVersion = "0.2";
@@ -0,0 +1,28 @@
+# Checks the node allocations of each top-level form listed in the expected file.
+# Before values were shared, each lookup of big copied all of its 10000 elements.
+# cmake -DSLISP=<slisp> -DSCRIPT=<script> -DEXPECTED=<expected counts> -P Allocations.cmake
+
+execute_process(
+  COMMAND ${SLISP} --alloc-stats ${SCRIPT}
+  ERROR_VARIABLE statistics
+  OUTPUT_QUIET
+  RESULT_VARIABLE result )
+if ( NOT result EQUAL 0 )
+  message( FATAL_ERROR "${SCRIPT} exited with ${result}" )
+endif()
+
+# Byte counts depend on the platform, so only the allocation counts are compared.
+string( REGEX REPLACE " bytes: [0-9]+" "" statistics "${statistics}" )
+
+file( STRINGS ${EXPECTED} expectedLines )
+foreach( expected ${expectedLines} )
+  string( FIND "${statistics}" "${expected}\n" position )
+  if ( position EQUAL -1 )
+    message( SEND_ERROR "Expected '${expected}'" )
+    set( isFailed TRUE )
+  endif()
+endforeach()
+
+if ( isFailed )
+  message( FATAL_ERROR "Allocations were:\n${statistics}" )
+endif()
@@ -0,0 +1,51 @@
+# Runs each example with the baseline options and with the candidate options.
+# Both must print the expected output, saved next to the example as <name>.expected, and exit with the same code.
+# Options are separated by spaces. Either may be empty.
+# cmake -DSLISP=<slisp> -DEXAMPLES=<directory> -DBASELINE=<options> -DCANDIDATE=<options> -P CompareModes.cmake
+
+separate_arguments( baselineOptions UNIX_COMMAND "${BASELINE}" )
+separate_arguments( candidateOptions UNIX_COMMAND "${CANDIDATE}" )
+
+file( GLOB examples ${EXAMPLES}/*.slisp )
+if ( NOT examples )
+  message( FATAL_ERROR "No examples in ${EXAMPLES}" )
+endif()
+
+foreach( example ${examples} )
+  get_filename_component( name ${example} NAME )
+  get_filename_component( stem ${example} NAME_WE )
+  if ( NOT EXISTS ${EXAMPLES}/${stem}.expected )
+    message( SEND_ERROR "${name} has no ${stem}.expected" )
+    set( isFailed TRUE )
+    continue()
+  endif()
+  file( READ ${EXAMPLES}/${stem}.expected expectedOutput )
+
+  execute_process(
+    COMMAND ${SLISP} ${baselineOptions} ${example}
+    OUTPUT_VARIABLE baselineOutput
+    ERROR_VARIABLE baselineOutput
+    RESULT_VARIABLE baselineResult )
+  execute_process(
+    COMMAND ${SLISP} ${candidateOptions} ${example}
+    OUTPUT_VARIABLE candidateOutput
+    ERROR_VARIABLE candidateOutput
+    RESULT_VARIABLE candidateResult )
+
+  if ( NOT baselineOutput STREQUAL expectedOutput )
+    message( SEND_ERROR "${name} printed with '${BASELINE}'\n${baselineOutput}\ninstead of\n${expectedOutput}" )
+    set( isFailed TRUE )
+  elseif ( NOT candidateOutput STREQUAL expectedOutput )
+    message( SEND_ERROR "${name} printed with '${CANDIDATE}'\n${candidateOutput}\ninstead of\n${expectedOutput}" )
+    set( isFailed TRUE )
+  elseif ( NOT candidateResult STREQUAL baselineResult )
+    message( SEND_ERROR "${name} exited with ${candidateResult} instead of ${baselineResult}" )
+    set( isFailed TRUE )
+  else()
+    message( STATUS "${name} agrees" )
+  endif()
+endforeach()
+
+if ( isFailed )
+  message( FATAL_ERROR "The options '${CANDIDATE}' and '${BASELINE}' disagree with the expected output" )
+endif()